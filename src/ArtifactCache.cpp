@@ -0,0 +1,243 @@
+#include "ArtifactCache.h"
+
+// Project Libraries
+#include <QStandardPaths>
+#include <QCryptographicHash>
+#include <QDirIterator>
+#include <QDateTime>
+#include <QSettings>
+#include <QFileInfo>
+#include <QFile>
+#include <QDir>
+#include <QDebug>
+#include <algorithm>
+#include <vector>
+
+
+
+// Per user and writable, unlike the folder of an installed executable
+QString ArtifactCache::cachePath()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/artifacts";
+}
+
+
+
+QString ArtifactCache::indexPath()
+{
+    return cachePath() + "/index.ini";
+}
+
+
+
+// Two levels, so no folder gets every entry
+QString ArtifactCache::entryPath(const QString &key)
+{
+    return cachePath() + "/" + key.left(2) + "/" + key;
+}
+
+
+
+QString ArtifactCache::key(const QString &fingerprint, const QString &kind, int segment, int channel, const QString &parameters)
+{
+    if (fingerprint.isEmpty()) {
+        return QString();
+    }
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    for (const QString &part : { fingerprint, kind, QString::number(segment), QString::number(channel), parameters }) {
+        hash.addData(part.toUtf8());
+        hash.addData("\n", 1);
+    }
+
+    return QString::fromLatin1(hash.result().toHex());
+}
+
+
+
+QString ArtifactCache::find(const QString &key)
+{
+    if (key.isEmpty()) {
+        return QString();
+    }
+
+    QSettings settings(indexPath(), QSettings::IniFormat);
+    if (!settings.contains("Artifacts/" + key + "/size")) {
+        return QString();
+    }
+
+    // Removed by hand, the index forgets it
+    QString entry = entryPath(key);
+    if (!QDir(entry).exists()) {
+        settings.remove("Artifacts/" + key);
+        return QString();
+    }
+
+    settings.setValue("Artifacts/" + key + "/used", QDateTime::currentMSecsSinceEpoch());
+    return entry;
+}
+
+
+
+QString ArtifactCache::insert(const QString &key, const QString &root, const QStringList &files, bool move)
+{
+    if (key.isEmpty() || files.isEmpty()) {
+        return QString();
+    }
+
+    // An entry larger than the budget would only evict everything else
+    qint64 size = 0;
+    for (const QString &file : files) {
+        size += QFileInfo(root + "/" + file).size();
+    }
+    if (size > budget()) {
+        return QString();
+    }
+
+    remove(key); // Same key, same artifact: the newer files replace it
+    QString entry = entryPath(key);
+    QStringList done;
+
+    for (const QString &file : files) {
+        QString source = root + "/" + file;
+        QString target = entry + "/" + file;
+        QDir().mkpath(QFileInfo(target).absolutePath());
+
+        bool ok = move ? (QFile::rename(source, target) || (QFile::copy(source, target) && QFile::remove(source)))
+                       : QFile::copy(source, target);
+        if (!ok) {
+            qDebug() << "Error: Artifact not cached" << source;
+
+            // What was moved goes back where it was
+            for (const QString &back : move ? done : QStringList()) {
+                QFile::rename(entry + "/" + back, root + "/" + back);
+            }
+            QDir(entry).removeRecursively();
+            return QString();
+        }
+        done.append(file);
+    }
+
+    {
+        QSettings settings(indexPath(), QSettings::IniFormat);
+        settings.setValue("Artifacts/" + key + "/size", size);
+        settings.setValue("Artifacts/" + key + "/used", QDateTime::currentMSecsSinceEpoch());
+    }
+
+    evict(key);
+    return entry;
+}
+
+
+
+// Existing files are replaced, a partial copy reports a miss so the caller recomputes
+bool ArtifactCache::restore(const QString &key, const QString &root, const QStringList &previous)
+{
+    QString entry = find(key);
+    if (entry.isEmpty()) {
+        return false;
+    }
+
+    for (const QString &path : previous) {
+        QFileInfo info(root + "/" + path);
+        if (info.isDir()) {
+            QDir(info.absoluteFilePath()).removeRecursively();
+        } else if (info.exists()) {
+            QFile::remove(info.absoluteFilePath());
+        }
+    }
+
+    QDir entryDir(entry);
+    QDirIterator it(entry, QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        QString source = it.next();
+        QString target = root + "/" + entryDir.relativeFilePath(source);
+        QDir().mkpath(QFileInfo(target).absolutePath());
+        QFile::remove(target);
+
+        if (!QFile::copy(source, target)) {
+            qDebug() << "Error: Artifact not restored" << target;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+
+QStringList ArtifactCache::files(const QString &root, const QString &folder)
+{
+    QStringList out;
+    for (const QString &name : QDir(root + "/" + folder).entryList(QDir::Files)) {
+        out.append(folder + "/" + name);
+    }
+    return out;
+}
+
+
+
+qint64 ArtifactCache::budget()
+{
+    QSettings settings(indexPath(), QSettings::IniFormat);
+    return settings.value("Budget", defaultBudget).toLongLong();
+}
+
+
+
+void ArtifactCache::setBudget(qint64 bytes)
+{
+    {
+        QSettings settings(indexPath(), QSettings::IniFormat);
+        settings.setValue("Budget", qMax(qint64(0), bytes));
+    }
+
+    evict(QString());
+}
+
+
+
+void ArtifactCache::remove(const QString &key)
+{
+    QDir(entryPath(key)).removeRecursively();
+
+    QSettings settings(indexPath(), QSettings::IniFormat);
+    settings.remove("Artifacts/" + key);
+}
+
+
+
+// Least recently used first, until the entries fit in the budget
+void ArtifactCache::evict(const QString &keep)
+{
+    struct Entry { QString key; qint64 size; qint64 used; };
+    std::vector<Entry> entries;
+    qint64 total = 0;
+
+    {
+        QSettings settings(indexPath(), QSettings::IniFormat);
+        settings.beginGroup("Artifacts");
+        for (const QString &key : settings.childGroups()) {
+            Entry e { key, settings.value(key + "/size").toLongLong(), settings.value(key + "/used").toLongLong() };
+            total += e.size;
+            entries.push_back(e);
+        }
+    }
+
+    qint64 limit = budget();
+    if (total <= limit) {
+        return;
+    }
+
+    std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) { return a.used < b.used; });
+    for (const Entry &e : entries) {
+        if (total <= limit) {
+            break;
+        }
+        if (e.key == keep) {
+            continue;
+        }
+        remove(e.key);
+        total -= e.size;
+    }
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <QString>
+#include <QStringList>
+
+// Derived results kept across sessions: spectrograms, and the results and maps of STEP00 and
+// STEP01 runs. An entry is keyed by the SHA-1 of the recording fingerprint (RecordingCache),
+// the kind of artifact, the segment, the channel and the parameters that produced it, so a
+// project reopened or evaluated again with parameters already used is put back instead of
+// recomputed. Entries are folders in the user's cache location (QStandardPaths), listed in
+// index.ini with their size and last use; past the byte budget the least recently used are
+// removed.
+class ArtifactCache
+{
+public:
+    // Empty without a recording, the cache is then skipped
+    static QString key(const QString &fingerprint, const QString &kind, int segment, int channel, const QString &parameters);
+
+    // Folder of the entry, empty on a miss; a hit counts as a use
+    static QString find(const QString &key);
+
+    // Copies (or moves) files given relative to root into a new entry and evicts down to the
+    // budget, the new entry last; its folder, empty when nothing was kept
+    static QString insert(const QString &key, const QString &root, const QStringList &files, bool move = false);
+
+    // Copies the files of an entry back under root, false on a miss. On a hit the files and
+    // folders of `previous` (relative to root) are removed first, so none of an earlier run stay
+    static bool restore(const QString &key, const QString &root, const QStringList &previous = QStringList());
+
+    // Relative paths of the files directly inside root/folder, none if it does not exist
+    static QStringList files(const QString &root, const QString &folder);
+
+    // Bytes, "Budget" in index.ini
+    static qint64 budget();
+    static void setBudget(qint64 bytes);
+
+private:
+    static constexpr qint64 defaultBudget = qint64(4) << 30;
+    static QString cachePath();
+    static QString indexPath();
+    static QString entryPath(const QString &key);
+    static void remove(const QString &key);
+    static void evict(const QString &keep);
+};
@@ -0,0 +1,315 @@
+#include "BehaviorChart.h"
+
+// Project Libraries
+#include <QPainter>
+#include <QMouseEvent>
+#include <QWheelEvent>
+#include <QHBoxLayout>
+#include <QVBoxLayout>
+#include <QToolTip>
+#include <QDebug>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
+
+
+// Constructor
+BehaviorChart::BehaviorChart(QWidget *parent)
+    : QWidget(parent)
+{
+    setMouseTracking(true);
+    setAutoFillBackground(true);
+
+    // Same order as MapAtlas::Layer and Statistic
+    metricComboBox = new QComboBox(this);
+    metricComboBox->addItems({ "Cardinality", "VoltageShiftDeviation" });
+    statisticComboBox = new QComboBox(this);
+    statisticComboBox->addItems({ "zscore of Σ", "Σ", "mean" });
+
+    QHBoxLayout *controls = new QHBoxLayout();
+    controls->addWidget(metricComboBox);
+    controls->addWidget(statisticComboBox);
+    controls->addStretch();
+
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->setContentsMargins(6, 6, 6, 6);
+    layout->addLayout(controls);
+    layout->addStretch();
+
+    connect(metricComboBox, qOverload<int>(&QComboBox::currentIndexChanged), this, [this]() { update(); });
+    connect(statisticComboBox, qOverload<int>(&QComboBox::currentIndexChanged), this, [this]() { update(); });
+}
+
+
+
+void BehaviorChart::reset(int segments)
+{
+    N = qMax(0, segments);
+    for (int m = 0; m < 2; m++) {
+        sums[m] = QVector<double>(N, std::numeric_limits<double>::quiet_NaN());
+        counts[m] = QVector<int>(N, 0);
+    }
+
+    viewStart = 0.0;
+    viewEnd = N;
+    update();
+}
+
+
+
+// More segments keep the sums already set, a view of all of them follows the new ones
+void BehaviorChart::setSegments(int segments)
+{
+    bool whole = (viewStart <= 0.0 && viewEnd >= N);
+    N = qMax(0, segments);
+    for (int m = 0; m < 2; m++) {
+        int old = sums[m].size();
+        sums[m].resize(N);
+        counts[m].resize(N);
+        for (int s = old; s < N; s++) {
+            sums[m][s] = std::numeric_limits<double>::quiet_NaN();
+            counts[m][s] = 0;
+        }
+    }
+
+    if (whole || viewEnd > N) {
+        viewStart = qMin(viewStart, double(N));
+        viewEnd = N;
+    }
+    update();
+}
+
+
+
+bool BehaviorChart::isEmpty() const
+{
+    return N == 0;
+}
+
+
+
+// Σ over the channels of one segment, as sum( Cardinality, dims = 1 ) did
+void BehaviorChart::setColumn(MapAtlas::Layer metric, int segment, const double *values, int channels)
+{
+    if (segment < 0 || segment >= N || values == nullptr) {
+        return;
+    }
+
+    double sum = 0.0;
+    int count = 0;
+    for (int ch = 0; ch < channels; ch++) {
+        if (std::isfinite(values[ch])) {
+            sum += values[ch];
+            count++;
+        }
+    }
+
+    sums[metric][segment] = (count > 0) ? sum : std::numeric_limits<double>::quiet_NaN();
+    counts[metric][segment] = count;
+    update();
+}
+
+
+
+void BehaviorChart::load(const ResultsStore &store)
+{
+    reset(store.segments());
+
+    for (int s = 0; s < N; s++) {
+        setColumn(MapAtlas::Cardinality, s, store.column("Cardinality", s), store.channels());
+        setColumn(MapAtlas::VoltageShiftDeviation, s, store.column("VoltageShiftDeviation", s), store.channels());
+    }
+}
+
+
+
+// Bar heights of the selected metric and statistic, NaN for segments not evaluated
+QVector<double> BehaviorChart::values() const
+{
+    int m = metricComboBox->currentIndex();
+    Statistic statistic = Statistic(statisticComboBox->currentIndex());
+    QVector<double> out = sums[m];
+
+    if (statistic == Mean) {
+        for (int s = 0; s < N; s++) {
+            out[s] = counts[m][s] > 0 ? out[s] / counts[m][s] : out[s];
+        }
+    } else if (statistic == ZScore) {
+        double mean = 0.0, var = 0.0;
+        int n = 0;
+        for (double v : out) {
+            if (std::isfinite(v)) { mean += v; n++; }
+        }
+        mean /= qMax(1, n);
+        for (double v : out) {
+            if (std::isfinite(v)) { var += (v - mean) * (v - mean); }
+        }
+        double sd = std::sqrt(var / qMax(1, n - 1));
+        if (!(sd > 0.0)) { sd = 1.0; }
+        for (double &v : out) {
+            v = (v - mean) / sd;
+        }
+    }
+
+    return out;
+}
+
+
+
+QRect BehaviorChart::plotRect() const
+{
+    int top = metricComboBox->geometry().bottom() + 12;
+    return QRect(QPoint(56, top), QPoint(width() - 12, height() - 28));
+}
+
+
+
+int BehaviorChart::segmentAt(int x) const
+{
+    QRect area = plotRect();
+    double s = viewStart + (x - area.left()) * (viewEnd - viewStart) / qMax(1, area.width());
+    return qBound(0, int(std::floor(s)), qMax(0, N - 1));
+}
+
+
+
+void BehaviorChart::setView(double start, double end)
+{
+    double span = qBound(qMin(4.0, double(N)), end - start, double(N));
+    start = qBound(0.0, start, N - span);
+    viewStart = start;
+    viewEnd = start + span;
+    update();
+}
+
+
+
+void BehaviorChart::paintEvent(QPaintEvent *event)
+{
+    Q_UNUSED(event);
+
+    QPainter painter(this);
+    painter.fillRect(rect(), Qt::white);
+    painter.setPen(Qt::gray);
+    painter.drawRect(rect().adjusted(0, 0, -1, -1));
+
+    QRect area = plotRect();
+    if (N == 0 || area.width() <= 0 || area.height() <= 0) {
+        painter.drawText(rect(), Qt::AlignCenter, "Evaluate or load a recording to see the Raw Bin Behavior");
+        return;
+    }
+
+    QVector<double> v = values();
+    int s0 = qMax(0, int(std::floor(viewStart)));
+    int s1 = qMin(N, int(std::ceil(viewEnd)));
+
+    // Vertical scale from the visible bars, always including 0
+    double lo = 0.0, hi = 0.0;
+    for (int s = s0; s < s1; s++) {
+        if (std::isfinite(v[s])) {
+            lo = qMin(lo, v[s]);
+            hi = qMax(hi, v[s]);
+        }
+    }
+    if (hi <= lo) {
+        hi = lo + 1.0;
+    }
+
+    auto X = [&](double s) { return area.left() + (s - viewStart) * area.width() / (viewEnd - viewStart); };
+    auto Y = [&](double y) { return area.bottom() - (y - lo) * area.height() / (hi - lo); };
+
+    // Bars (royalblue3, as BarPlot)
+    QColor barColor(58, 95, 205);
+    for (int s = s0; s < s1; s++) {
+        if (!std::isfinite(v[s])) {
+            continue;
+        }
+        double x0 = X(s), x1 = X(s + 1);
+        double gap = (x1 - x0 > 4.0) ? 1.0 : 0.0;
+        painter.fillRect(QRectF(QPointF(x0 + gap, Y(qMax(0.0, v[s]))), QPointF(x1 - gap, Y(qMin(0.0, v[s])))), barColor);
+    }
+
+    // Axes and labels
+    painter.setPen(Qt::black);
+    painter.drawLine(area.bottomLeft(), area.topLeft());
+    painter.drawLine(QPointF(area.left(), Y(0.0)), QPointF(area.right(), Y(0.0)));
+    painter.drawText(QRect(0, area.top() - 6, area.left() - 4, 14), Qt::AlignRight, QString::number(hi, 'g', 3));
+    painter.drawText(QRect(0, area.bottom() - 8, area.left() - 4, 14), Qt::AlignRight, QString::number(lo, 'g', 3));
+
+    int step = qMax(1, (s1 - s0) / 10);
+    for (int s = (s0 / step) * step; s < s1; s += step) {
+        double x = X(s + 0.5);
+        if (x >= area.left()) {
+            painter.drawText(QRectF(x - 20, area.bottom() + 4, 40, 14), Qt::AlignHCenter, QString::number(s + 1));
+        }
+    }
+    painter.drawText(QRect(area.left(), height() - 14, area.width(), 14), Qt::AlignHCenter, "n bin");
+}
+
+
+
+// Zoom around the segment under the pointer
+void BehaviorChart::wheelEvent(QWheelEvent *event)
+{
+    if (N == 0) {
+        return;
+    }
+
+    QRect area = plotRect();
+    double at = viewStart + (event->position().x() - area.left()) * (viewEnd - viewStart) / qMax(1, area.width());
+    double factor = (event->angleDelta().y() > 0) ? 0.8 : 1.25;
+    setView(at - (at - viewStart) * factor, at + (viewEnd - at) * factor);
+}
+
+
+
+void BehaviorChart::mousePressEvent(QMouseEvent *event)
+{
+    if (event->button() == Qt::LeftButton) {
+        dragX = event->x();
+        dragged = false;
+    }
+}
+
+
+
+void BehaviorChart::mouseMoveEvent(QMouseEvent *event)
+{
+    QRect area = plotRect();
+
+    if (dragX >= 0 && (event->buttons() & Qt::LeftButton)) {
+        double shift = (dragX - event->x()) * (viewEnd - viewStart) / qMax(1, area.width());
+        dragged = dragged || std::abs(event->x() - dragX) > 2;
+        dragX = event->x();
+        setView(viewStart + shift, viewEnd + shift);
+        return;
+    }
+
+    if (N > 0 && area.contains(event->pos())) {
+        int s = segmentAt(event->x());
+        QVector<double> v = values();
+        QString text = std::isfinite(v[s]) ? QString("Segment %1: %2").arg(s + 1).arg(v[s], 0, 'g', 4)
+                                           : QString("Segment %1: not evaluated").arg(s + 1);
+        QToolTip::showText(event->globalPos(), text, this);
+    }
+}
+
+
+
+// A click that did not pan selects the segment
+void BehaviorChart::mouseReleaseEvent(QMouseEvent *event)
+{
+    if (event->button() == Qt::LeftButton && dragX >= 0 && !dragged && N > 0 && plotRect().contains(event->pos())) {
+        emit segmentSelected(segmentAt(event->x()));
+    }
+    dragX = -1;
+}
+
+
+
+void BehaviorChart::mouseDoubleClickEvent(QMouseEvent *event)
+{
+    Q_UNUSED(event);
+    setView(0.0, N);
+}
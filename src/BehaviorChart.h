@@ -0,0 +1,59 @@
+#pragma once
+
+#include <QWidget>
+#include <QComboBox>
+#include <QVector>
+#include "MapAtlas.h"
+#include "ResultsStore.h"
+
+// Raw Bin Behavior: one bar per segment with the sum, the mean or the z-score of the sums of
+// Cardinality or VoltageShiftDeviation over the channels. The sums are accumulated as each
+// STEP00 segment finishes (or read from the results store), so the chart is live during an
+// evaluation and needs no Julia. The wheel zooms on the segments, dragging pans, a double
+// click shows them all and clicking a bar selects its segment.
+class BehaviorChart : public QWidget
+{
+    Q_OBJECT
+
+public:
+    enum Statistic { ZScore, Sum, Mean };
+
+    // Constructor
+    BehaviorChart(QWidget *parent = nullptr);
+
+    // My public functions
+    void reset(int segments);
+    void setSegments(int segments);
+    void setColumn(MapAtlas::Layer metric, int segment, const double *values, int channels);
+    void load(const ResultsStore &store);
+    bool isEmpty() const;
+
+signals:
+    void segmentSelected(int segment); // 0-based
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void wheelEvent(QWheelEvent *event) override;
+    void mousePressEvent(QMouseEvent *event) override;
+    void mouseMoveEvent(QMouseEvent *event) override;
+    void mouseReleaseEvent(QMouseEvent *event) override;
+    void mouseDoubleClickEvent(QMouseEvent *event) override;
+
+private:
+    QVector<double> values() const;
+    QRect plotRect() const;
+    int segmentAt(int x) const;
+    void setView(double start, double end);
+
+    QComboBox *metricComboBox;
+    QComboBox *statisticComboBox;
+
+    int N = 0;
+    QVector<double> sums[2];   // Per segment, NaN until evaluated
+    QVector<int> counts[2];    // Finite channels of each sum
+
+    double viewStart = 0.0;    // Segments shown, fractional while zooming
+    double viewEnd = 0.0;
+    int dragX = -1;
+    bool dragged = false;
+};
@@ -0,0 +1,255 @@
+#include "CompareWindow.h"
+
+// Project Libraries
+#include <QFileDialog>
+#include <QFileInfo>
+#include <QMessageBox>
+#include <QPushButton>
+#include <QScrollArea>
+#include <QVBoxLayout>
+#include <QDebug>
+#include "RecordingCache.h"
+
+
+
+// Constructor
+CompareWindow::CompareWindow(const QStringList &steps, QWidget *parent)
+    : QWidget(parent, Qt::Window)
+{
+    setWindowTitle("Compare recordings");
+    resize(1100, 820);
+
+    QPushButton *addButton = new QPushButton("Add recording...", this);
+    stepComboBox = new QComboBox(this);
+    stepComboBox->addItems(steps);
+    segmentSlider = new QSlider(Qt::Horizontal, this);
+    segmentSlider->setRange(0, 0);
+    segmentLabel = new QLabel(this);
+    segmentLabel->setMinimumWidth(110);
+
+    QHBoxLayout *controls = new QHBoxLayout();
+    controls->addWidget(addButton);
+    controls->addWidget(stepComboBox);
+    controls->addWidget(segmentSlider, 1);
+    controls->addWidget(segmentLabel);
+
+    // One column per recording, scrolled when they do not fit
+    QWidget *columns = new QWidget();
+    columnsLayout = new QHBoxLayout(columns);
+    columnsLayout->addStretch();
+
+    QScrollArea *scrollArea = new QScrollArea(this);
+    scrollArea->setWidgetResizable(true);
+    scrollArea->setWidget(columns);
+
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->addLayout(controls);
+    layout->addWidget(scrollArea, 1);
+
+    connect(addButton, &QPushButton::clicked, this, &CompareWindow::addClicked);
+    connect(stepComboBox, &QComboBox::currentTextChanged, this, &CompareWindow::stepChanged);
+    connect(segmentSlider, &QSlider::valueChanged, this, &CompareWindow::segmentChanged);
+}
+
+
+
+void CompareWindow::addClicked()
+{
+    QStringList fileNames = QFileDialog::getOpenFileNames(this, "Select BRW files", QString(), "BRW Files (*.brw)");
+
+    for (const QString &fileName : fileNames) {
+        addRecording(fileName);
+    }
+}
+
+
+
+// Only results found through the fingerprint registry or next to the BRW are shown
+bool CompareWindow::addRecording(const QString &brwPath)
+{
+    QString fingerprint = RecordingCache::fingerprint(brwPath);
+    if (fingerprint.isEmpty()) {
+        QMessageBox::warning(this, "File not found", "Verify that the path is correct: " + brwPath);
+        return false;
+    }
+
+    for (const auto &recording : recordings) {
+        if (recording->fingerprint == fingerprint) {
+            return true; // Same contents, maybe under another name
+        }
+    }
+
+    QString projectPath = RecordingCache::project(fingerprint);
+    if (projectPath.isEmpty() || !RecordingCache::hasResults(projectPath)) {
+        projectPath = RecordingCache::defaultProject(brwPath);
+    }
+
+    if (!RecordingCache::hasResults(projectPath)) {
+        QMessageBox::warning(this, "Not evaluated",
+                             QString("'%1' has no results yet. Evaluate it first, the comparison never computes them.")
+                                 .arg(QFileInfo(brwPath).fileName()));
+        return false;
+    }
+    RecordingCache::remember(fingerprint, projectPath);
+
+    auto recording = std::make_unique<Recording>();
+    recording->brwPath = brwPath;
+    recording->projectPath = projectPath;
+    recording->fingerprint = fingerprint;
+
+    recording->column = new QWidget();
+    recording->title = new QLabel(QFileInfo(brwPath).fileName(), recording->column);
+    recording->title->setToolTip(projectPath);
+    QPushButton *removeButton = new QPushButton("Remove", recording->column);
+
+    // Hovering is mirrored on every map, a click does not draw a spectrogram here
+    recording->viewer = new FigureViewer(recording->column);
+    recording->viewer_STD = new FigureViewer(recording->column);
+
+    QHBoxLayout *header = new QHBoxLayout();
+    header->addWidget(recording->title, 1);
+    header->addWidget(removeButton);
+
+    QVBoxLayout *columnLayout = new QVBoxLayout(recording->column);
+    columnLayout->addLayout(header);
+    columnLayout->addWidget(recording->viewer);
+    columnLayout->addWidget(recording->viewer_STD);
+    columnLayout->addStretch();
+
+    Recording *added = recording.get();
+    for (FigureViewer *viewer : { added->viewer, added->viewer_STD }) {
+        viewer->setSpectrogramsEnabled(false);
+        connect(viewer, &FigureViewer::currentChannelChanged, this, &CompareWindow::channelChanged);
+    }
+    connect(removeButton, &QPushButton::clicked, this, [this, added]() { removeRecording(added); });
+
+    columnsLayout->insertWidget(columnsLayout->count() - 1, recording->column);
+    recordings.push_back(std::move(recording));
+
+    updateRange();
+    showSegment();
+    return true;
+}
+
+
+
+void CompareWindow::removeRecording(Recording *recording)
+{
+    for (auto it = recordings.begin(); it != recordings.end(); ++it) {
+        if (it->get() == recording) {
+            recording->column->deleteLater();
+            recordings.erase(it);
+            break;
+        }
+    }
+
+    updateRange();
+    showSegment();
+}
+
+
+
+// The viewers may show mapped memory, so they are cleared before unmapping
+void CompareWindow::closeAtlases()
+{
+    for (const auto &recording : recordings) {
+        recording->viewer->clear();
+        recording->viewer_STD->clear();
+        for (auto &atlas : recording->atlases) {
+            atlas.second.close();
+        }
+    }
+}
+
+
+
+void CompareWindow::refresh()
+{
+    updateRange();
+    showSegment();
+}
+
+
+
+MapAtlas *CompareWindow::stepAtlas(Recording &recording)
+{
+    QString step = stepComboBox->currentText();
+    MapAtlas *stepAtlas = &recording.atlases[step];
+
+    if (!stepAtlas->isOpen() && !stepAtlas->openStep(recording.projectPath, step)) {
+        qDebug() << "Error: No" << step << "maps for" << recording.projectPath;
+    }
+
+    return stepAtlas;
+}
+
+
+
+// The slider covers the longest recording, the shorter ones are blank past their end
+void CompareWindow::updateRange()
+{
+    int segments = 0;
+    for (const auto &recording : recordings) {
+        segments = qMax(segments, stepAtlas(*recording)->count());
+    }
+
+    const QSignalBlocker blocker(segmentSlider);
+    segmentSlider->setRange(0, qMax(0, segments - 1));
+}
+
+
+
+void CompareWindow::stepChanged(const QString &step)
+{
+    Q_UNUSED(step);
+    updateRange();
+    showSegment();
+}
+
+
+
+void CompareWindow::segmentChanged(int segment)
+{
+    Q_UNUSED(segment);
+    showSegment();
+}
+
+
+
+void CompareWindow::showSegment()
+{
+    int segment = segmentSlider->value();
+    segmentLabel->setText(QString("Segment %1 / %2").arg(segment + 1).arg(segmentSlider->maximum() + 1));
+
+    for (const auto &recording : recordings) {
+        MapAtlas *atlas = stepAtlas(*recording);
+
+        if (segment < atlas->count()) {
+            recording->viewer->setImage(atlas->map(segment, MapAtlas::Cardinality));
+            recording->viewer_STD->setImage(atlas->map(segment, MapAtlas::VoltageShiftDeviation));
+        } else {
+            recording->viewer->clear();
+            recording->viewer_STD->clear();
+        }
+    }
+}
+
+
+
+// The channel under the pointer is marked on the maps of every recording
+void CompareWindow::channelChanged(int channel)
+{
+    if (syncing) {
+        return;
+    }
+
+    syncing = true;
+    for (const auto &recording : recordings) {
+        for (FigureViewer *viewer : { recording->viewer, recording->viewer_STD }) {
+            if (viewer != sender()) {
+                viewer->markChannel(channel);
+            }
+        }
+    }
+    syncing = false;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <QWidget>
+#include <QComboBox>
+#include <QSlider>
+#include <QLabel>
+#include <QHBoxLayout>
+#include <map>
+#include <memory>
+#include <vector>
+#include "FigureViewer.h"
+#include "MapAtlas.h"
+
+// Side by side maps of several recordings that were already evaluated. Each recording keeps
+// its own atlases mapped, so moving the shared segment slider or the hovered channel (mirrored
+// on every map) only reads images from memory: nothing is recomputed and no raw data is read.
+class CompareWindow : public QWidget
+{
+    Q_OBJECT
+
+public:
+    // Constructor
+    CompareWindow(const QStringList &steps, QWidget *parent = nullptr);
+
+    // My public functions
+    bool addRecording(const QString &brwPath);
+
+    // Unmaps every atlas so they can be rewritten, refresh maps them again
+    void closeAtlases();
+    void refresh();
+
+private slots:
+    void addClicked();
+    void stepChanged(const QString &step);
+    void segmentChanged(int segment);
+    void channelChanged(int channel);
+
+private:
+    struct Recording {
+        QString brwPath;
+        QString projectPath;
+        QString fingerprint;
+        std::map<QString, MapAtlas> atlases; // Opened on first use, kept mapped
+        QWidget *column;
+        QLabel *title;
+        FigureViewer *viewer;
+        FigureViewer *viewer_STD;
+    };
+
+    void removeRecording(Recording *recording);
+    MapAtlas *stepAtlas(Recording &recording);
+    void updateRange();
+    void showSegment();
+
+    std::vector<std::unique_ptr<Recording>> recordings;
+
+    QComboBox *stepComboBox;
+    QSlider *segmentSlider;
+    QLabel *segmentLabel;
+    QHBoxLayout *columnsLayout;
+    bool syncing = false;
+};
@@ -0,0 +1,212 @@
+#include "FigureExport.h"
+
+// Project Libraries
+#include <QCoreApplication>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QPainter>
+#include <QFileInfo>
+#include <QFile>
+#include <QDir>
+#include <QDebug>
+#include <atomic>
+#include <cmath>
+
+// Layout of the former GR composite of STEP01: 800x500, the title in the top 10 % and the maps at 48 % and
+// 52 % of the width
+static const int compositeWidth = 800;
+static const int compositeHeight = 500;
+static const char *compositeTitle = "Second evaluation, Repaired Data";
+
+
+
+QImage FigureExport::loadColorbar(const ResultsStore &store)
+{
+    return QImage(QCoreApplication::applicationDirPath() + "/resources/cbar/" + store.colormap() + ".png");
+}
+
+
+
+// "BIN" + lpad( n, n0s, "0" ), as the figures written by Julia
+QString FigureExport::segmentName(int segment, int segments)
+{
+    int digits = QString::number(segments).size();
+    return QString("BIN%1").arg(segment + 1, digits, 10, QChar('0'));
+}
+
+
+
+// Segments left without results by a cancelled run are NaN columns, nothing to draw
+bool FigureExport::hasResults(const ResultsStore &store, int segment)
+{
+    const double *values = store.column("Cardinality", segment);
+    if (values == nullptr) {
+        return false;
+    }
+    for (int ch = 0; ch < store.channels(); ch++) {
+        if (std::isfinite(values[ch])) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+
+// Every segment with results on the pool threads, the GUI waits for them (a few seconds for
+// hundreds of segments); false when the store cannot be read or a figure was not written
+bool FigureExport::writeStep(const QString &storePath, const QString &figuresPath, bool composites)
+{
+    ResultsStore store;
+    if (!store.open(storePath)) {
+        qDebug() << "Error: No results store to draw" << storePath;
+        return false;
+    }
+
+    QImage colorbar = loadColorbar(store);
+    if (colorbar.isNull() || !QDir().mkpath(figuresPath)) {
+        qDebug() << "Error: No colorbar or figures folder for" << storePath;
+        return false;
+    }
+
+    int N = store.segments();
+    std::atomic<int> failures(0);
+    QThreadPool pool;
+
+    for (int s = 0; s < N; s++) {
+        pool.start(QRunnable::create([&store, &colorbar, &failures, figuresPath, composites, s, N]() {
+            QString base = figuresPath + "/" + segmentName(s, N);
+
+            // Figures of a previous run would otherwise stand in for the missing segment
+            if (!hasResults(store, s)) {
+                for (const QString &suffix : { "_.png", "_std.png", ".png" }) {
+                    QFile::remove(base + suffix);
+                }
+                return;
+            }
+
+            if (!store.render("Cardinality", s, colorbar).save(base + "_.png")) {
+                failures++;
+            }
+            if (!store.render("VoltageShiftDeviation", s, colorbar).save(base + "_std.png")) {
+                failures++;
+            }
+
+            // A deferred composite must not be one of a previous run
+            if (composites) {
+                if (!composite(store, s, colorbar).save(base + ".png")) {
+                    failures++;
+                }
+            } else {
+                QFile::remove(base + ".png");
+            }
+        }));
+    }
+    pool.waitForDone();
+
+    if (failures > 0) {
+        qDebug() << "Error:" << int(failures) << "figures not written in" << figuresPath;
+    }
+    return failures == 0;
+}
+
+
+
+// The composites deferred by writeStep, only those missing; returns how many were written
+int FigureExport::writeComposites(const QString &storePath, const QString &figuresPath)
+{
+    ResultsStore store;
+    if (!store.open(storePath)) {
+        return 0;
+    }
+
+    int N = store.segments();
+    QList<int> missing;
+    for (int s = 0; s < N; s++) {
+        if (hasResults(store, s) && !QFileInfo::exists(figuresPath + "/" + segmentName(s, N) + ".png")) {
+            missing.append(s);
+        }
+    }
+
+    QImage colorbar = loadColorbar(store);
+    if (missing.isEmpty() || colorbar.isNull()) {
+        return 0;
+    }
+
+    std::atomic<int> written(0);
+    QThreadPool pool;
+    for (int s : missing) {
+        pool.start(QRunnable::create([&store, &colorbar, &written, figuresPath, s, N]() {
+            if (composite(store, s, colorbar).save(figuresPath + "/" + segmentName(s, N) + ".png")) {
+                written++;
+            }
+        }));
+    }
+    pool.waitForDone();
+
+    return written;
+}
+
+
+
+QImage FigureExport::composite(const ResultsStore &store, int segment, const QImage &colorbar)
+{
+    QImage image(compositeWidth, compositeHeight, QImage::Format_RGB32);
+    image.fill(Qt::white);
+
+    QPainter painter(&image);
+    painter.setRenderHint(QPainter::TextAntialiasing);
+    painter.setFont(QFont("sans-serif", 10));
+    painter.setPen(Qt::black);
+
+    int top = compositeHeight / 10;
+    int split = int(compositeWidth * 0.48);
+    painter.drawText(QRect(0, 0, compositeWidth, top), Qt::AlignHCenter | Qt::AlignBottom, compositeTitle);
+
+    QRect left(0, top, split, compositeHeight - top);
+    QRect right(split, top, compositeWidth - split, compositeHeight - top);
+    drawPanel(painter, left, store, "Cardinality", "Cardinality of the Voltage", segment, colorbar);
+    drawPanel(painter, right, store, "VoltageShiftDeviation", "Voltage Shift Deviation", segment, colorbar);
+
+    return image;
+}
+
+
+
+// One Zplot: its title, the map without smoothing and the colorbar between -c and c
+void FigureExport::drawPanel(QPainter &painter, const QRect &area, const ResultsStore &store, const QString &matrix,
+                             const QString &title, int segment, const QImage &colorbar)
+{
+    double c = 0.0;
+    QImage map = store.render(matrix, segment, colorbar, &c);
+
+    painter.drawText(QRect(area.left(), area.top(), area.width(), 24), Qt::AlignCenter, title);
+    if (map.isNull()) {
+        return;
+    }
+
+    const int barWidth = 14;
+    const int labelWidth = 40;
+    int side = qMin(area.width() - barWidth - labelWidth - 24, area.height() - 40);
+    QRect mapRect(area.left() + 8, area.top() + 28, side, side);
+    painter.drawImage(mapRect, map);
+    painter.drawRect(mapRect.adjusted(0, 0, -1, -1));
+
+    // Colorbar, c at the top
+    QRect barRect(mapRect.right() + 10, mapRect.top(), barWidth, side);
+    QImage bar = colorbar.convertToFormat(QImage::Format_RGB32);
+    const QRgb *barLine = reinterpret_cast<const QRgb *>(bar.constScanLine(bar.height() / 2));
+    for (int y = 0; y < side; y++) {
+        double t = 1.0 - double(y) / qMax(1, side - 1);
+        painter.setPen(QColor(barLine[int(t * (bar.width() - 1))]));
+        painter.drawLine(barRect.left(), barRect.top() + y, barRect.right(), barRect.top() + y);
+    }
+
+    painter.setPen(Qt::black);
+    painter.drawRect(barRect.adjusted(0, 0, -1, -1));
+    double span = (c > 0.0) ? 2.0 * c : 1.0;
+    for (double v : { c, 0.0, -c }) {
+        int y = barRect.top() + int((c - v) / span * (side - 1));
+        painter.drawText(QRect(barRect.right() + 4, y - 8, labelWidth, 16), Qt::AlignLeft | Qt::AlignVCenter, QString::number(v, 'f', 1));
+    }
+}
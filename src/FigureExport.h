@@ -0,0 +1,27 @@
+#pragma once
+
+#include <QImage>
+#include <QString>
+#include "ResultsStore.h"
+
+class QPainter;
+
+// Native STEP01 figures drawn from the results store instead of GR: the two 64x64 GUI maps of
+// every segment (BINnn_.png and BINnn_std.png, as ResultsStore::render) and the 800x500
+// composite that STEP01 drew with GR (BINnn.png: title, both maps and their colorbars). The
+// segments with results are drawn and encoded to PNG on the threads of a QThreadPool. The
+// composites can be left for later and written by writeComposites when they are asked for.
+class FigureExport
+{
+public:
+    static bool writeStep(const QString &storePath, const QString &figuresPath, bool composites);
+    static int writeComposites(const QString &storePath, const QString &figuresPath);
+    static QImage composite(const ResultsStore &store, int segment, const QImage &colorbar);
+
+private:
+    static QImage loadColorbar(const ResultsStore &store);
+    static bool hasResults(const ResultsStore &store, int segment);
+    static QString segmentName(int segment, int segments);
+    static void drawPanel(QPainter &painter, const QRect &area, const ResultsStore &store, const QString &matrix,
+                          const QString &title, int segment, const QImage &colorbar);
+};
@@ -5,8 +5,16 @@
 #include <QMouseEvent>
 #include <QImage>
 #include <QMessageBox>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
 #include <QDebug>
 #include <julia.h>
+#include "ArtifactCache.h"
+#include "SpectrogramFigure.h"
+
+QHash<QString, QString> FigureViewer::spectrogramCache;
+QString FigureViewer::recording;
 
 // Constructor
 FigureViewer::FigureViewer(QWidget *parent)
@@ -26,6 +34,10 @@ FigureViewer::FigureViewer(QWidget *parent)
     }
 
     image = img;
+
+    dwellTimer = new QTimer(this);
+    dwellTimer->setSingleShot(true);
+    connect(dwellTimer, &QTimer::timeout, this, &FigureViewer::prefetchSpectrograms);
 }
 
 
@@ -45,6 +57,18 @@ void FigureViewer::setImage(const QString &imagePath)
 
 
 
+// Maps from the atlas are shown as they are, without decoding a file
+void FigureViewer::setImage(const QImage &newImage)
+{
+    if (newImage.size() == QSize(64, 64)) {
+        imageLoaded = true;
+        image = newImage;
+        update();
+    }
+}
+
+
+
 void FigureViewer::paintEvent(QPaintEvent *event)
 {
     QPainter painter(this);
@@ -65,6 +89,19 @@ void FigureViewer::paintEvent(QPaintEvent *event)
             painter.fillRect(rect, color);
         }
     }
+
+    if (!roi.isEmpty()) {
+        painter.setPen(QPen(Qt::black, 1, Qt::DashLine));
+        painter.drawRect(roi.x() * pixelSize, roi.y() * pixelSize, roi.width() * pixelSize - 1, roi.height() * pixelSize - 1);
+    }
+
+    // Banner over maps computed from sampled frames only
+    if (approximate) {
+        QRect banner(0, 0, 64 * pixelSize, painter.fontMetrics().height() + 4);
+        painter.fillRect(banner, QColor(255, 255, 255, 200));
+        painter.setPen(Qt::darkRed);
+        painter.drawText(banner, Qt::AlignCenter, "Approximate (quick look)");
+    }
 }
 
 
@@ -78,15 +115,36 @@ void FigureViewer::mouseMoveEvent(QMouseEvent *event)
     if (x >= 0 && x < 64 && y >= 0 && y < 64) {
         hoveredX = x;
         hoveredY = y;
+        if (roiDragging) {
+            roi = QRect(roiStart, QPoint(x, y)).normalized();
+        }
         update();
 
         int currentChannel = (y * 64) + (x + 1);
+
+        // Moving to another channel drops what was anticipated for the previous one
+        if (currentChannel != m_currentChannel && imageLoaded && scheduler != nullptr) {
+            scheduler->dropPrefetch();
+            dwellTimer->start(dwellTime);
+        }
         setCurrentChannel(currentChannel);
     }
 }
 
 
 
+void FigureViewer::leaveEvent(QEvent *event)
+{
+    dwellTimer->stop();
+    if (scheduler != nullptr) {
+        scheduler->dropPrefetch();
+    }
+
+    QWidget::leaveEvent(event);
+}
+
+
+
 void FigureViewer::mousePressEvent(QMouseEvent *event)
 {
     // Checking if FigureViewer is empty
@@ -98,27 +156,215 @@ void FigureViewer::mousePressEvent(QMouseEvent *event)
     int x = event->x() / pixelSize;
     int y = event->y() / pixelSize;
 
+    // The right button drags a region of interest instead
+    if (event->button() == Qt::RightButton) {
+        if (x >= 0 && x < 64 && y >= 0 && y < 64) {
+            roiStart = QPoint(x, y);
+            roi = QRect(roiStart, roiStart);
+            roiDragging = true;
+            update();
+        }
+        return;
+    }
+
     if (x >= 0 && x < 64 && y >= 0 && y < 64) {
         int pixelNumber = y * 64 + x + 1;
 
+        // Maps of other recordings only select, their spectrograms need their Julia state
+        if (!spectrogramsEnabled) {
+            emit channelSelected(pixelNumber);
+            return;
+        }
+
         // Calling 'evalJuliaString' function
         evalJuliaInt("segment", BINSelected);
         evalJuliaInt("channelSpectro", pixelNumber);
         evalJuliaInt("n1", n1);
         evalJuliaInt("n_overlap1", n_overlap1);
+        emit channelSelected(pixelNumber);
+
+        // Usually prefetched by the hover already, otherwise it runs now or at the next poll of a
+        // running batch (a newer click replaces it)
+        int segment = BINSelected;
+        if (scheduler != nullptr) {
+            scheduler->submit(JobScheduler::Interactive, "spectrogram", [this, segment, pixelNumber]() { showSpectrogram(segment, pixelNumber); });
+        } else {
+            showSpectrogram(segment, pixelNumber);
+        }
+    }
+}
+
+
+
+void FigureViewer::showSpectrogram(int segment, int channel)
+{
+    QString filename = spectrogramFile(segment, channel);
+    qDebug() << "Spectro Path: " << filename;
+
+    setFilename(filename);
+}
+
+
+
+// Cached figure of a channel; on a miss Julia computes the series and the figure is drawn here
+QString FigureViewer::spectrogramFile(int segment, int channel)
+{
+    QString key = cacheKey(segment, channel);
+    auto cached = spectrogramCache.constFind(key);
+
+    if (cached != spectrogramCache.constEnd()) {
+        if (QFile::exists(cached.value())) {
+            return cached.value();
+        }
+        spectrogramCache.remove(key); // Evicted from the artifact cache since
+    }
+
+    // Drawn in an earlier session
+    QString artifact = artifactKey(segment, channel);
+    QString entry = ArtifactCache::find(artifact);
+    if (!entry.isEmpty()) {
+        QString filename = entry + "/" + QDir(entry).entryList({ "*.png" }, QDir::Files).value(0);
+        spectrogramCache.insert(key, filename);
+        return filename;
+    }
+
+    // No global is touched, a batch segment may be halfway through
+    QString binName = QString("joinpath( PATHSTEP00, string( \"BIN\", lpad( %1, n0s, \"0\" ), \".jld2\" ) )").arg(segment);
+    QString call = QString("SpectrogramSeries( Variables, %1, %2, N, Streaming, %3, %4, %5, PATHSPECTROGRAMS )")
+                       .arg(binName).arg(segment).arg(channel).arg(n1).arg(n_overlap1);
+
+    // Assign the file name from Julia to a C object of Julia type
+    QString name = juliaStringValue(call);
+    QString filename = name + ".png";
+    bool written = !name.isEmpty() && SpectrogramFigure::write(name + ".spg", filename);
+    QFile::remove(name + ".spg");
+    if (!written) {
+        qDebug() << "Error: Spectrogram not drawn for channel" << channel << "of segment" << segment;
+        return QString();
+    }
+
+    // Figures/Spectrograms does not grow with every click
+    QFileInfo drawn(filename);
+    entry = ArtifactCache::insert(artifact, drawn.absolutePath(), { drawn.fileName() }, true);
+    if (!entry.isEmpty()) {
+        filename = entry + "/" + drawn.fileName();
+    }
+    spectrogramCache.insert(key, filename);
+
+    return filename;
+}
+
+
+
+// The frames of the segment stand for N, the window and the segment length
+QString FigureViewer::artifactKey(int segment, int channel)
+{
+    if (recording.isEmpty()) {
+        return QString();
+    }
+
+    QString frames = QString("SegmentFrames( Variables, %1, N )").arg(segment);
+    QString parameters = QString("frames=%1:%2;n1=%3;n_overlap1=%4;version=%5")
+                             .arg(juliaIntValue(frames + "[ 1 ]")).arg(juliaIntValue(frames + "[ 2 ]"))
+                             .arg(n1).arg(n_overlap1).arg(juliaIntValue("ArtifactVersion"));
+
+    return ArtifactCache::key(recording, "SPECTROGRAM", segment, channel, parameters);
+}
+
+
+
+QString FigureViewer::cacheKey(int segment, int channel) const
+{
+    return QString("%1:%2:%3:%4").arg(segment).arg(channel).arg(n1).arg(n_overlap1);
+}
+
+
+
+// The hovered channel first, then its 8 neighbours on the array, computed while the GUI is idle
+void FigureViewer::prefetchSpectrograms()
+{
+    if (!imageLoaded || scheduler == nullptr || scheduler->isBatchRunning() || hoveredX < 0) {
+        return;
+    }
+
+    emit prefetchRequested(); // Lets the window load the Julia state of the project first
+
+    int segment = BINSelected;
+    for (int dy : { 0, -1, 1 }) {
+        for (int dx : { 0, -1, 1 }) {
+            int x = hoveredX + dx;
+            int y = hoveredY + dy;
+            if (x < 0 || x >= 64 || y < 0 || y >= 64) {
+                continue;
+            }
+
+            int channel = y * 64 + x + 1;
+            QString cached = spectrogramCache.value(cacheKey(segment, channel));
+            if (!cached.isEmpty() && QFile::exists(cached)) {
+                continue;
+            }
+
+            scheduler->submit(JobScheduler::Prefetch, cacheKey(segment, channel), [this, segment, channel]() {
+                spectrogramFile(segment, channel);
+            });
+        }
+    }
+}
+
+
+
+// A right click without dragging clears the region
+void FigureViewer::mouseReleaseEvent(QMouseEvent *event)
+{
+    if (event->button() != Qt::RightButton || !roiDragging) {
+        return;
+    }
+
+    roiDragging = false;
+    if (roi.width() == 1 && roi.height() == 1) {
+        roi = QRect();
+    }
+    update();
+
+    emit roiSelected(roi);
+}
+
+
+
+void FigureViewer::setRoi(const QRect &newRoi)
+{
+    roi = newRoi;
+    update();
+}
 
-        jl_eval_string("BINNAME = joinpath( PATHSTEP00, string( \"BIN\", lpad( segment, n0s, \"0\" ), \".jld2\" ) );");
-        jl_eval_string("BINPATCH = Float64.( LoadDict( BINNAME ) );");
-        jl_eval_string("p = Channel_Spectrogram(BINPATCH, channelSpectro, n1, n_overlap1);");
-        jl_eval_string("filename_string = joinpath( PATHSPECTROGRAMS, \"BIN_$(lpad(segment, n0s, \"0\"))_Channel_$channelSpectro\");");
-        jl_eval_string("Plots.png(p, filename_string);");
 
-        // Assign the filename_string from Julia to a C object of Julia type
-        QString filename = juliaStringValue("filename_string") + ".png";
-        qDebug() << "Spectro Path: " << filename;
 
-        setFilename(filename);
+// Marks a channel as the hover does, e.g. when the trend view jumps to it
+void FigureViewer::markChannel(int channel)
+{
+    if (channel < 1 || channel > 64 * 64) {
+        return;
     }
+
+    hoveredX = (channel - 1) % 64;
+    hoveredY = (channel - 1) / 64;
+    setCurrentChannel(channel);
+    update();
+}
+
+
+
+void FigureViewer::setSpectrogramsEnabled(bool enabled)
+{
+    spectrogramsEnabled = enabled;
+}
+
+
+
+void FigureViewer::setApproximate(bool newApproximate)
+{
+    approximate = newApproximate;
+    update();
 }
 
 
@@ -145,6 +391,13 @@ void FigureViewer::SpectroParametersNoverLap(int &n_overlap1_ComboBox)
 
 
 
+void FigureViewer::setScheduler(JobScheduler *jobScheduler)
+{
+    scheduler = jobScheduler;
+}
+
+
+
 QString FigureViewer::filename() const
 {
     return m_filename;
@@ -197,6 +450,7 @@ void FigureViewer::clear()
     // Reset hover
     hoveredX = -1;
     hoveredY = -1;
+    dwellTimer->stop();
 
     // View refresh
     imageLoaded = false;
@@ -204,6 +458,21 @@ void FigureViewer::clear()
 }
 
 
+// Spectrograms of another run (or project) must not be served
+void FigureViewer::clearSpectrogramCache()
+{
+    spectrogramCache.clear();
+}
+
+
+
+void FigureViewer::setRecording(const QString &fingerprint)
+{
+    recording = fingerprint;
+}
+
+
+
 // Function to jl_eval_string
 void FigureViewer::evalJulia(const QString& key, const QString& value) {
     QString evalString = key + " = " + value + ";";
@@ -232,6 +501,9 @@ QString FigureViewer::juliaStringValue(const QString& juliaVar)
     const char *varConst = varUtf.constData();
 
     jl_value_t *value = jl_eval_string(varConst);
+    if (value == nullptr) {
+        return QString(); // The expression threw
+    }
     const char *value_str = jl_string_ptr(value);
 
     return QString::fromUtf8(value_str);
@@ -1,6 +1,9 @@
 #pragma once
 
 #include <QWidget>
+#include <QHash>
+#include <QTimer>
+#include "JobScheduler.h"
 
 class FigureViewer : public QWidget
 {
@@ -14,9 +17,15 @@ public:
 
     // My public function
     void setImage(const QString &imagePath);
+    void setImage(const QImage &newImage);
     void BINSelected_Func(int &BINSelected_ComboBox);
     void SpectroParametersN1(int &n1_ComboBox);
     void SpectroParametersNoverLap(int &n_overlap1_ComboBox);
+    void setScheduler(JobScheduler *jobScheduler);
+    void setRoi(const QRect &newRoi);
+    void markChannel(int channel);
+    void setSpectrogramsEnabled(bool enabled);
+    void setApproximate(bool approximate);
 
     // Q_PROPERTY WRITE
     void setFilename(const QString &filename);
@@ -28,6 +37,8 @@ public:
 
     // My Public auxiliar functions
     void clear();
+    static void clearSpectrogramCache();
+    static void setRecording(const QString &fingerprint);
 
     // My Public variables
     int BINSelected = 1;
@@ -38,12 +49,17 @@ signals:
     // Q_PROPERTY NOTIFY
     void filenameChanged(const QString &filename);
     void currentChannelChanged(int currentChannel);
+    void channelSelected(int channel);
+    void prefetchRequested();
+    void roiSelected(const QRect &roi);
 
 
 protected:
     void paintEvent(QPaintEvent *event) override;
     void mouseMoveEvent(QMouseEvent *event) override;
     void mousePressEvent(QMouseEvent *event) override;
+    void mouseReleaseEvent(QMouseEvent *event) override;
+    void leaveEvent(QEvent *event) override;
 
 private:
     QImage image;
@@ -52,8 +68,33 @@ private:
     int hoveredY = -1;
     bool imageLoaded = false;
 
+    // Region of interest of the array, dragged with the right button
+    QRect roi;
+    QPoint roiStart;
+    bool roiDragging = false;
+
     QString m_filename;
     int m_currentChannel;
+    bool spectrogramsEnabled = true;
+    bool approximate = false; // Quick-look maps, see PreviewSegment
+
+    // Spectrograms are interactive jobs, they may run inside a batch
+    JobScheduler *scheduler = nullptr;
+    void showSpectrogram(int segment, int channel);
+    QString spectrogramFile(int segment, int channel);
+
+    // Hover prefetch: after a short dwell the spectrograms of the hovered channel and its
+    // neighbours are computed ahead of the click, one idle job each (the STFT in Julia, the
+    // figure drawn natively by SpectrogramFigure); the cache is shared by both viewers
+    QTimer *dwellTimer;
+    static constexpr int dwellTime = 250; // ms
+    static QHash<QString, QString> spectrogramCache;
+    QString cacheKey(int segment, int channel) const;
+
+    // Spectrograms drawn are moved into the artifact cache, kept across sessions
+    static QString recording; // Fingerprint of the BRW, empty skips the cache
+    QString artifactKey(int segment, int channel);
+    void prefetchSpectrograms();
 
     // Julia auxiliar Functions
     void evalJulia(const QString& key, const QString& value);
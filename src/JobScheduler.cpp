@@ -0,0 +1,224 @@
+#include "JobScheduler.h"
+
+// Project Libraries
+#include <QCoreApplication>
+#include <QTimer>
+#include <QDebug>
+
+JobScheduler *JobScheduler::active = nullptr;
+
+// Called by Julia (ccall through SchedulerPoll[ ]) from the thread that owns the GUI
+extern "C" int JobSchedulerPoll()
+{
+    JobScheduler *scheduler = JobScheduler::current();
+    return scheduler ? scheduler->poll() : 0;
+}
+
+
+
+// Constructor
+JobScheduler::JobScheduler(QObject *parent)
+    : QObject(parent)
+{
+    active = this;
+}
+
+
+
+JobScheduler::~JobScheduler()
+{
+    if (active == this) {
+        active = nullptr;
+    }
+}
+
+
+
+JobScheduler *JobScheduler::current()
+{
+    return active;
+}
+
+
+
+quintptr JobScheduler::pollAddress()
+{
+    return reinterpret_cast<quintptr>(&JobSchedulerPoll);
+}
+
+
+
+// Outside a batch job an interactive job runs right away, as a direct call would
+void JobScheduler::submit(Priority priority, const QString &key, std::function<void()> task)
+{
+    if (priority == Batch) {
+        batchJobs.push_back({ key, std::move(task) });
+        return;
+    }
+
+    // Speculative work never slows a batch down, and a key already queued is kept once
+    if (priority == Prefetch) {
+        if (batchRunning) {
+            return;
+        }
+        for (const Job &job : prefetchJobs) {
+            if (job.key == key) {
+                return;
+            }
+        }
+        prefetchJobs.push_back({ key, std::move(task) });
+
+        if (!prefetchScheduled) {
+            prefetchScheduled = true;
+            QTimer::singleShot(0, this, &JobScheduler::runPrefetch);
+        }
+        return;
+    }
+
+    for (auto it = interactiveJobs.begin(); it != interactiveJobs.end(); ++it) {
+        if (it->key == key) {
+            interactiveJobs.erase(it);
+            break;
+        }
+    }
+    interactiveJobs.push_back({ key, std::move(task) });
+
+    if (!inBatchJob && !inInteractive) {
+        runInteractive();
+    }
+}
+
+
+
+// Drains the batch queue, interactive jobs first; false when it was cancelled
+bool JobScheduler::run()
+{
+    while (true) {
+        QCoreApplication::processEvents();
+        runInteractive();
+
+        if (canceled) {
+            batchJobs.clear();
+            return false;
+        }
+
+        if (batchJobs.empty()) {
+            return true;
+        }
+
+        Job job = std::move(batchJobs.front());
+        batchJobs.pop_front();
+        inBatchJob = true;
+        job.task();
+        inBatchJob = false;
+    }
+}
+
+
+
+// Kernels may call it once per block, the events are processed at most every pollInterval
+int JobScheduler::poll()
+{
+    if (!batchRunning || inInteractive) {
+        return 0;
+    }
+
+    if (!pollClock.isValid() || pollClock.elapsed() >= pollInterval) {
+        pollClock.restart();
+        QCoreApplication::processEvents();
+        runInteractive();
+    }
+
+    return canceled ? 1 : 0;
+}
+
+
+
+void JobScheduler::runInteractive()
+{
+    if (inInteractive) {
+        return;
+    }
+
+    inInteractive = true;
+    while (!interactiveJobs.empty()) {
+        Job job = std::move(interactiveJobs.front());
+        interactiveJobs.pop_front();
+        job.task();
+    }
+    inInteractive = false;
+}
+
+
+
+// One job per pass, so the events in between (a move, a click) can drop the rest
+void JobScheduler::runPrefetch()
+{
+    prefetchScheduled = false;
+
+    if (prefetchJobs.empty() || batchRunning || inInteractive) {
+        return;
+    }
+
+    Job job = std::move(prefetchJobs.front());
+    prefetchJobs.pop_front();
+    job.task();
+
+    if (!prefetchJobs.empty() && !prefetchScheduled) {
+        prefetchScheduled = true;
+        QTimer::singleShot(0, this, &JobScheduler::runPrefetch);
+    }
+}
+
+
+
+void JobScheduler::dropPrefetch()
+{
+    prefetchJobs.clear();
+}
+
+
+
+void JobScheduler::beginBatch()
+{
+    batchRunning = true;
+    canceled = false;
+    prefetchJobs.clear();
+    pollClock.invalidate();
+}
+
+
+
+void JobScheduler::endBatch()
+{
+    batchRunning = false;
+    batchJobs.clear();
+
+    // What was clicked during the last segment still runs
+    runInteractive();
+}
+
+
+
+bool JobScheduler::isBatchRunning() const
+{
+    return batchRunning;
+}
+
+
+
+bool JobScheduler::isCanceled() const
+{
+    return canceled;
+}
+
+
+
+void JobScheduler::cancel()
+{
+    if (batchRunning) {
+        canceled = true;
+        qDebug() << "Batch cancelled";
+        emit cancelRequested();
+    }
+}
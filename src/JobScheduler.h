@@ -0,0 +1,71 @@
+#pragma once
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QString>
+#include <deque>
+#include <functional>
+
+// Cooperative scheduler of the GUI thread, the only one allowed to call into Julia. Batch jobs
+// (STEP00/STEP01 segments) run one after another; interactive jobs (spectrograms, traces) run
+// right away while no batch job is executing (between segments, or while a follow waits for
+// the recording to grow) and also inside a running one, whenever a kernel polls from its
+// chunk loop (ForChannels calls poll() through the SchedulerPoll pointer). The same poll tells
+// the kernels when the batch was cancelled, so Cancel is honoured within one block of channels.
+// Prefetch jobs (the spectrograms around the hovered channel) only run while the GUI is idle, one
+// per event loop pass, and are dropped as a whole when what they anticipated is no longer wanted.
+class JobScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Priority { Interactive, Batch, Prefetch };
+
+    // Constructor
+    JobScheduler(QObject *parent = nullptr);
+    ~JobScheduler();
+
+    // My public functions
+    void submit(Priority priority, const QString &key, std::function<void()> task);
+    void dropPrefetch();
+    bool run();
+    int poll();
+
+    void beginBatch();
+    void endBatch();
+    bool isBatchRunning() const;
+    bool isCanceled() const;
+
+    // Address of the C callback for Julia's SchedulerPoll[ ]
+    static quintptr pollAddress();
+    static JobScheduler *current();
+
+signals:
+    void cancelRequested();
+
+public slots:
+    void cancel();
+
+private:
+    struct Job {
+        QString key; // Pending interactive jobs with the same key are replaced
+        std::function<void()> task;
+    };
+
+    void runInteractive();
+    void runPrefetch();
+
+    static constexpr int pollInterval = 20; // ms, well below the 100 ms a click may wait
+
+    std::deque<Job> interactiveJobs;
+    std::deque<Job> batchJobs;
+    std::deque<Job> prefetchJobs;
+    bool prefetchScheduled = false;
+    QElapsedTimer pollClock;
+    bool batchRunning = false;
+    bool inBatchJob = false;
+    bool canceled = false;
+    bool inInteractive = false;
+
+    static JobScheduler *active;
+};
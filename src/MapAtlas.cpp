@@ -0,0 +1,267 @@
+#include "MapAtlas.h"
+
+// Project Libraries
+#include <QDir>
+#include <QCoreApplication>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QDebug>
+#include <cstring>
+
+static const char atlasMagic[8] = { 'E', 'V', 'A', 'L', 'A', 'T', 'L', 'S' };
+static const quint32 atlasVersion = 1;
+
+
+
+MapAtlas::~MapAtlas()
+{
+    close();
+}
+
+
+
+qint64 MapAtlas::mapsOffset(int count)
+{
+    return sizeof(Header) + qint64(count) * nameSize;
+}
+
+
+
+bool MapAtlas::build(const QString &figuresDir, const QString &atlasPath)
+{
+    QDir dir(figuresDir);
+    QStringList files = dir.entryList({ "*_.png" }, QDir::Files, QDir::Name);
+
+    // Only segments with both maps go into the atlas
+    QStringList names;
+    for (const QString &file : files) {
+        QString name = QFileInfo(file).completeBaseName();
+        if (dir.exists(name + "std.png")) {
+            names.append(name);
+        }
+    }
+
+    const QStringList suffixes = { ".png", "std.png" };
+    return write(atlasPath, names, [&](int n, Layer layer) {
+        return QImage(dir.filePath(names[n] + suffixes[layer]));
+    });
+}
+
+
+
+bool MapAtlas::build(const ResultsStore &store, const QImage &colorbar, const QString &atlasPath)
+{
+    // Same names as the figures of a run: BIN + zero padded segment + _
+    int digits = QString::number(store.segments()).size();
+    QStringList names;
+    for (int n = 1; n <= store.segments(); n++) {
+        names.append(QString("BIN%1_").arg(n, digits, 10, QChar('0')));
+    }
+
+    // STEP stores hold Cardinality and VSD, the band, spike and connectivity ones Left and Right
+    const QStringList matrices = store.column("Cardinality", 0) != nullptr ? QStringList { "Cardinality", "VoltageShiftDeviation" }
+                                                                            : QStringList { "Left", "Right" };
+    return write(atlasPath, names, [&](int n, Layer layer) {
+        return store.render(matrices[layer], n, colorbar);
+    });
+}
+
+
+
+bool MapAtlas::write(const QString &atlasPath, const QStringList &names, const std::function<QImage(int, Layer)> &mapOf)
+{
+    QFile out(atlasPath + ".tmp");
+    if (!out.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qDebug() << "Error: Could not write atlas" << out.fileName();
+        return false;
+    }
+
+    Header header;
+    std::memcpy(header.magic, atlasMagic, sizeof(atlasMagic));
+    header.version = atlasVersion;
+    header.side = side;
+    header.layers = layers;
+    header.count = names.size();
+    out.write(reinterpret_cast<const char *>(&header), sizeof(Header));
+
+    // Index: one fixed-size name per segment
+    for (const QString &name : names) {
+        out.write(name.toUtf8().left(nameSize - 1).leftJustified(nameSize, '\0', true));
+    }
+
+    // Maps: segment-major, Cardinality then VSD, as RGB32 scanlines
+    for (int n = 0; n < names.size(); n++) {
+        for (Layer layer : { Cardinality, VoltageShiftDeviation }) {
+            QImage img = mapOf(n, layer);
+            if (img.size() != QSize(side, side)) {
+                img = QImage(side, side, QImage::Format_RGB32);
+                img.fill(Qt::white);
+            }
+            img = img.convertToFormat(QImage::Format_RGB32);
+
+            for (int y = 0; y < side; y++) {
+                out.write(reinterpret_cast<const char *>(img.constScanLine(y)), side * 4);
+            }
+        }
+    }
+
+    out.close();
+
+    // On Windows a file still mapped somewhere cannot be replaced, the old atlas is kept
+    if ((QFile::exists(atlasPath) && !QFile::remove(atlasPath)) || !out.rename(atlasPath)) {
+        qDebug() << "Error: Could not replace atlas" << atlasPath;
+        out.remove();
+        return false;
+    }
+    return true;
+}
+
+
+
+bool MapAtlas::isStale(const QString &sourcePath, const QString &atlasPath)
+{
+    QFileInfo atlasInfo(atlasPath);
+    if (!atlasInfo.exists()) {
+        return true;
+    }
+
+    // PNGs overwritten in place do not touch the folder, its newest file counts (the folder
+    // itself still tells about files added or removed)
+    QFileInfo sourceInfo(sourcePath);
+    QDateTime newest = sourceInfo.lastModified();
+    if (sourceInfo.isDir()) {
+        for (const QFileInfo &figure : QDir(sourcePath).entryInfoList(QDir::Files)) {
+            newest = qMax(newest, figure.lastModified());
+        }
+    }
+
+    return newest > atlasInfo.lastModified();
+}
+
+
+
+bool MapAtlas::open(const QString &atlasPath)
+{
+    close();
+
+    file.setFileName(atlasPath);
+    if (!file.open(QIODevice::ReadOnly) || file.size() < qint64(sizeof(Header))) {
+        file.close();
+        return false;
+    }
+
+    data = file.map(0, file.size());
+    if (data == nullptr) {
+        file.close();
+        return false;
+    }
+
+    // Validating the header against the file size
+    Header header;
+    std::memcpy(&header, data, sizeof(Header));
+
+    qint64 expected = mapsOffset(header.count) + qint64(header.count) * layers * mapBytes;
+    bool valid = std::memcmp(header.magic, atlasMagic, sizeof(atlasMagic)) == 0
+                 && header.version == atlasVersion && header.side == side
+                 && header.layers == layers && file.size() == expected;
+
+    if (!valid) {
+        qDebug() << "Error: Invalid atlas" << atlasPath;
+        close();
+        return false;
+    }
+
+    segments = header.count;
+    return true;
+}
+
+
+
+// Atlas of a step of a project (Figures/<step>.atlas) from its figures or, without them, from
+// Info/<step>.res; only when missing or older than its source unless forced
+bool MapAtlas::buildStep(const QString &projectPath, const QString &step, bool force)
+{
+    QString figuresPath = projectPath + "/Figures/" + step;
+    QString storePath = projectPath + "/Info/" + step + ".res";
+    QString atlasPath = figuresPath + ".atlas";
+
+    if (QDir(figuresPath).exists()) {
+        return (!force && !isStale(figuresPath, atlasPath)) || build(figuresPath, atlasPath);
+    }
+    if (!QFileInfo::exists(storePath)) {
+        return false;
+    }
+    if (!force && !isStale(storePath, atlasPath)) {
+        return true;
+    }
+
+    // Without figures the maps are drawn from the results store, no Julia needed
+    ResultsStore store;
+    if (!store.open(storePath)) {
+        return false;
+    }
+    QDir().mkpath(QFileInfo(atlasPath).absolutePath());
+    QImage colorbar(QCoreApplication::applicationDirPath() + "/resources/cbar/" + store.colormap() + ".png");
+    return build(store, colorbar, atlasPath);
+}
+
+
+
+bool MapAtlas::openStep(const QString &projectPath, const QString &step)
+{
+    buildStep(projectPath, step, false);
+    return open(projectPath + "/Figures/" + step + ".atlas");
+}
+
+
+
+void MapAtlas::close()
+{
+    if (data != nullptr) {
+        file.unmap(data);
+        data = nullptr;
+    }
+
+    file.close();
+    segments = 0;
+}
+
+
+
+bool MapAtlas::isOpen() const
+{
+    return data != nullptr;
+}
+
+
+
+int MapAtlas::count() const
+{
+    return segments;
+}
+
+
+
+QStringList MapAtlas::names() const
+{
+    QStringList list;
+    for (int n = 0; n < segments; n++) {
+        const char *name = reinterpret_cast<const char *>(data + sizeof(Header) + qint64(n) * nameSize);
+        list.append(QString::fromUtf8(name, int(strnlen(name, nameSize))));
+    }
+
+    return list;
+}
+
+
+
+// The image shares the mapped memory: no decode and no copy
+QImage MapAtlas::map(int segment, Layer layer) const
+{
+    if (data == nullptr || segment < 0 || segment >= segments) {
+        return QImage();
+    }
+
+    const uchar *bits = data + mapsOffset(segments) + (qint64(segment) * layers + layer) * mapBytes;
+    return QImage(bits, side, side, side * 4, QImage::Format_RGB32);
+}
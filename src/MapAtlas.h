@@ -0,0 +1,59 @@
+#pragma once
+
+#include <QFile>
+#include <QImage>
+#include <QString>
+#include <QStringList>
+#include <functional>
+#include "ResultsStore.h"
+
+// One indexed binary file holding every 64x64 map of a step (Cardinality and VSD of each
+// segment, or the left and right maps of a band, spikes or connectivity). It is memory-mapped on open, so switching segments is an offset, not a PNG decode.
+class MapAtlas
+{
+public:
+    enum Layer { Cardinality = 0, VoltageShiftDeviation = 1 };
+
+    // Constructor
+    MapAtlas() = default;
+    ~MapAtlas();
+
+    // Builds the atlas from the BINxxx_.png / BINxxx_std.png figures of a directory
+    static bool build(const QString &figuresDir, const QString &atlasPath);
+    // Or renders it from a results store (Info/STEPxx.res), without any figure
+    static bool build(const ResultsStore &store, const QImage &colorbar, const QString &atlasPath);
+    static bool isStale(const QString &sourcePath, const QString &atlasPath);
+    // Figures/<step>.atlas of a project from whichever of the two it has
+    static bool buildStep(const QString &projectPath, const QString &step, bool force = true);
+
+    // My public functions
+    bool open(const QString &atlasPath);
+    bool openStep(const QString &projectPath, const QString &step);
+    void close();
+    bool isOpen() const;
+
+    int count() const;
+    QStringList names() const;
+    QImage map(int segment, Layer layer) const;
+
+private:
+    struct Header {
+        char magic[8];
+        quint32 version;
+        quint32 side;
+        quint32 layers;
+        quint32 count;
+    };
+
+    static constexpr int side = 64;
+    static constexpr int layers = 2;
+    static constexpr int nameSize = 16;
+    static constexpr qint64 mapBytes = side * side * 4;
+
+    static qint64 mapsOffset(int count);
+    static bool write(const QString &atlasPath, const QStringList &names, const std::function<QImage(int, Layer)> &mapOf);
+
+    QFile file;
+    uchar *data = nullptr;
+    int segments = 0;
+};
@@ -0,0 +1,82 @@
+#include "RecordingCache.h"
+
+// Project Libraries
+#include <QStandardPaths>
+#include <QCryptographicHash>
+#include <QSettings>
+#include <QFileInfo>
+#include <QFile>
+#include <QDir>
+#include <QDebug>
+
+
+
+// Per user and writable, unlike the folder of an installed executable
+QString RecordingCache::registryPath()
+{
+    QString folder = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+    QDir().mkpath(folder);
+    return folder + "/recordings.ini";
+}
+
+
+
+QString RecordingCache::fingerprint(const QString &brwPath)
+{
+    QFile file(brwPath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qDebug() << "Error: Recording not readable" << brwPath;
+        return QString();
+    }
+
+    qint64 size = file.size();
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(QByteArray::number(size));
+
+    for (qint64 offset : { qint64(0), (size - sampleSize) / 2, size - sampleSize }) {
+        if (file.seek(qMax(qint64(0), offset))) {
+            hash.addData(file.read(sampleSize));
+        }
+    }
+
+    return QString::fromLatin1(hash.result().toHex());
+}
+
+
+
+QString RecordingCache::project(const QString &fingerprint)
+{
+    if (fingerprint.isEmpty()) {
+        return QString();
+    }
+
+    QSettings settings(registryPath(), QSettings::IniFormat);
+    return settings.value("Recordings/" + fingerprint).toString();
+}
+
+
+
+void RecordingCache::remember(const QString &fingerprint, const QString &projectPath)
+{
+    if (fingerprint.isEmpty() || projectPath.isEmpty()) {
+        return;
+    }
+
+    QSettings settings(registryPath(), QSettings::IniFormat);
+    settings.setValue("Recordings/" + fingerprint, QDir(projectPath).absolutePath());
+}
+
+
+
+QString RecordingCache::defaultProject(const QString &brwPath)
+{
+    QFileInfo fileInfo(brwPath);
+    return QDir(fileInfo.absoluteDir().absolutePath() + "/..").absolutePath() + "/" + fileInfo.baseName();
+}
+
+
+
+bool RecordingCache::hasResults(const QString &projectPath)
+{
+    return QFileInfo::exists(projectPath + "/Info/STEP00.res") || QDir(projectPath + "/Figures/STEP00").exists();
+}
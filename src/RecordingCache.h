@@ -0,0 +1,26 @@
+#pragma once
+
+#include <QString>
+
+// Where the results of a recording live, keyed by a fingerprint of the BRW contents rather than
+// its path, so a copied or renamed recording still finds the project evaluated before and
+// nothing is recomputed. The registry is recordings.ini in the user's application data
+// location (QStandardPaths).
+class RecordingCache
+{
+public:
+    // SHA-1 of the size and of the first, middle and last MiB, a full hash of a multi-GB
+    // recording would read all of it
+    static QString fingerprint(const QString &brwPath);
+
+    static QString project(const QString &fingerprint);
+    static void remember(const QString &fingerprint, const QString &projectPath);
+
+    // <brw folder>/../<brw name>, where CODE_STEP_00 writes the results
+    static QString defaultProject(const QString &brwPath);
+    static bool hasResults(const QString &projectPath);
+
+private:
+    static constexpr qint64 sampleSize = 1 << 20;
+    static QString registryPath();
+};
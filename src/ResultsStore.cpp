@@ -0,0 +1,209 @@
+#include "ResultsStore.h"
+
+// Project Libraries
+#include <QVector>
+#include <QDebug>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+static const char resultsMagic[8] = { 'E', 'V', 'A', 'L', 'R', 'E', 'S', '1' };
+
+
+
+ResultsStore::~ResultsStore()
+{
+    close();
+}
+
+
+
+bool ResultsStore::open(const QString &storePath)
+{
+    close();
+
+    file.setFileName(storePath);
+    if (!file.open(QIODevice::ReadOnly) || file.size() < headerSize) {
+        file.close();
+        return false;
+    }
+
+    data = file.map(0, file.size());
+    if (data == nullptr || std::memcmp(data, resultsMagic, sizeof(resultsMagic)) != 0) {
+        qDebug() << "Error: Invalid results store" << storePath;
+        close();
+        return false;
+    }
+
+    // Header: nChs, N, nMatrices, nTables, nLists, colormap
+    qint64 header[5];
+    std::memcpy(header, data + 8, sizeof(header));
+    nChs = header[0];
+    N = header[1];
+    cmap = QString::fromUtf8(reinterpret_cast<const char *>(data + 48), int(strnlen(reinterpret_cast<const char *>(data + 48), 16)));
+
+    // Directory, every section is checked against the file size
+    qint64 nEntries = header[2] + header[3] + header[4];
+    for (qint64 e = 0; e < nEntries; e++) {
+        const uchar *entry = data + headerSize + e * entrySize;
+        if (headerSize + (e + 1) * entrySize > file.size()) {
+            break;
+        }
+
+        Entry item;
+        item.kind = e < header[2] ? Matrix : (e < header[2] + header[3] ? Table : List);
+        std::memcpy(&item.offset, entry + nameSize, sizeof(qint64));
+        std::memcpy(&item.count, entry + nameSize + 8, sizeof(qint64));
+
+        qint64 bytes = item.kind == Matrix ? nChs * N * 8 : (item.kind == Table ? item.count * 16 : item.count * 4);
+        if (item.offset < 0 || item.offset + bytes > file.size()) {
+            qDebug() << "Error: Truncated results store" << storePath;
+            close();
+            return false;
+        }
+
+        const char *name = reinterpret_cast<const char *>(entry);
+        entries.insert(QString::fromUtf8(name, int(strnlen(name, nameSize))), item);
+    }
+
+    return true;
+}
+
+
+
+void ResultsStore::close()
+{
+    if (data != nullptr) {
+        file.unmap(data);
+        data = nullptr;
+    }
+
+    file.close();
+    entries.clear();
+    nChs = 0;
+    N = 0;
+}
+
+
+
+bool ResultsStore::isOpen() const
+{
+    return data != nullptr;
+}
+
+
+
+int ResultsStore::channels() const
+{
+    return int(nChs);
+}
+
+
+
+int ResultsStore::segments() const
+{
+    return int(N);
+}
+
+
+
+QString ResultsStore::colormap() const
+{
+    return cmap;
+}
+
+
+
+// Segment is 0-based, the column holds nChs values (NaN if it was not evaluated)
+const double *ResultsStore::column(const QString &matrix, int segment) const
+{
+    auto entry = entries.constFind(matrix);
+    if (entry == entries.constEnd() || entry->kind != Matrix || segment < 0 || segment >= N) {
+        return nullptr;
+    }
+
+    return reinterpret_cast<const double *>(data + entry->offset) + qint64(segment) * nChs;
+}
+
+
+
+const ResultsStore::Interval *ResultsStore::table(const QString &name, qint64 &count) const
+{
+    auto entry = entries.constFind(name);
+    if (entry == entries.constEnd() || entry->kind != Table) {
+        count = 0;
+        return nullptr;
+    }
+
+    count = entry->count;
+    return reinterpret_cast<const Interval *>(data + entry->offset);
+}
+
+
+
+const qint32 *ResultsStore::list(const QString &name, qint64 &count) const
+{
+    auto entry = entries.constFind(name);
+    if (entry == entries.constEnd() || entry->kind != List) {
+        count = 0;
+        return nullptr;
+    }
+
+    count = entry->count;
+    return reinterpret_cast<const qint32 *>(data + entry->offset);
+}
+
+
+
+QImage ResultsStore::render(const QString &matrix, int segment, const QImage &colorbar, double *limit) const
+{
+    const double *values = column(matrix, segment);
+    int side = int(std::lround(std::sqrt(double(nChs))));
+    if (values == nullptr || side * side != nChs || colorbar.isNull()) {
+        return QImage();
+    }
+
+    // Empty channels do not count for the statistics (PatchEmpties in Julia)
+    QVector<bool> empty(int(nChs), false);
+    qint64 nEmpties = 0;
+    const qint32 *empties = list("Empties", nEmpties);
+    for (qint64 e = 0; e < nEmpties; e++) {
+        if (empties[e] >= 1 && empties[e] <= nChs) {
+            empty[empties[e] - 1] = true;
+        }
+    }
+
+    QVector<double> valid;
+    for (int ch = 0; ch < nChs; ch++) {
+        if (!empty[ch] && std::isfinite(values[ch])) {
+            valid.append(values[ch]);
+        }
+    }
+
+    double mean = 0.0, var = 0.0;
+    for (double v : valid) { mean += v; }
+    mean /= qMax(1, valid.size());
+    for (double v : valid) { var += (v - mean) * (v - mean); }
+    double sd = std::sqrt(var / qMax(1, valid.size() - 1));
+    if (sd <= 0.0) { sd = 1.0; }
+
+    // Color limits as Zplot: ± ( median + 2 std ) of the z-scores, std of z-scores is 1
+    std::sort(valid.begin(), valid.end());
+    double median = valid.isEmpty() ? mean : valid[valid.size() / 2];
+    double c = std::abs((median - mean) / sd + 2.0);
+    if (limit != nullptr) {
+        *limit = c;
+    }
+
+    QImage bar = colorbar.convertToFormat(QImage::Format_RGB32);
+    const QRgb *barLine = reinterpret_cast<const QRgb *>(bar.constScanLine(bar.height() / 2));
+
+    QImage img(side, side, QImage::Format_RGB32);
+    for (int ch = 0; ch < nChs; ch++) {
+        double z = (empty[ch] || !std::isfinite(values[ch])) ? (median - mean) / sd : (values[ch] - mean) / sd;
+        double t = (qBound(-c, z, c) + c) / (2.0 * c);
+        img.setPixel(ch % side, ch / side, barLine[int(t * (bar.width() - 1))]);
+    }
+
+    return img;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <QFile>
+#include <QHash>
+#include <QImage>
+#include <QString>
+
+// Reader of the Info/STEPxx.res results store written by SaveResults (AllSTEPs.jl): dense
+// nChs x N Float64 matrices, sparse saturation interval tables and Int32 lists, memory-mapped
+// so a project can be restored and drawn without Julia, reading only the columns used.
+class ResultsStore
+{
+public:
+    struct Interval {
+        qint32 segment; // 1-based, as in Julia
+        qint32 channel;
+        qint32 first;   // Frames inside the segment
+        qint32 last;
+    };
+
+    // Constructor
+    ResultsStore() = default;
+    ~ResultsStore();
+
+    // My public functions
+    bool open(const QString &storePath);
+    void close();
+    bool isOpen() const;
+
+    int channels() const;
+    int segments() const;
+    QString colormap() const;
+
+    const double *column(const QString &matrix, int segment) const;
+    const Interval *table(const QString &name, qint64 &count) const;
+    const qint32 *list(const QString &name, qint64 &count) const;
+
+    // 64x64 map of one segment, z-scored and colored with the colorbar like Zplot; limit
+    // receives the color limit c of the z-scores ( -c to c )
+    QImage render(const QString &matrix, int segment, const QImage &colorbar, double *limit = nullptr) const;
+
+private:
+    enum Kind { Matrix, Table, List };
+
+    struct Entry {
+        Kind kind;
+        qint64 offset;
+        qint64 count;
+    };
+
+    static constexpr int headerSize = 64;
+    static constexpr int entrySize = 48;
+    static constexpr int nameSize = 32;
+
+    QFile file;
+    uchar *data = nullptr;
+    QHash<QString, Entry> entries;
+    qint64 nChs = 0;
+    qint64 N = 0;
+    QString cmap;
+};
@@ -0,0 +1,68 @@
+#include "SegmentArena.h"
+
+// Project Libraries
+#include <QtGlobal>
+#include <QDebug>
+#include <julia.h>
+
+
+
+// Julia is already shut down here, so the buffers are only freed
+SegmentArena::~SegmentArena()
+{
+    for (Buffer &buffer : buffers) {
+        qFreeAligned(buffer.data);
+    }
+}
+
+
+
+bool SegmentArena::bind(const QString &name, qint64 elements)
+{
+    Buffer &buffer = buffers[name];
+
+    // Growing replaces the buffer, Julia must drop the old one and every view of it first
+    if (buffer.capacity < elements) {
+        unbind(name);
+        qFreeAligned(buffer.data);
+        buffer.data = static_cast<double *>(qMallocAligned(size_t(elements) * sizeof(double), alignment));
+        buffer.capacity = buffer.data ? elements : 0;
+
+        if (buffer.data == nullptr) {
+            qDebug() << "Error: Could not allocate the arena buffer" << name << elements;
+            return false;
+        }
+    }
+
+    jl_value_t *type = jl_apply_array_type(reinterpret_cast<jl_value_t *>(jl_float64_type), 1);
+    jl_array_t *array = jl_ptr_to_array_1d(type, buffer.data, size_t(buffer.capacity), 0);
+    JL_GC_PUSH1(&array);
+    jl_set_global(jl_main_module, jl_symbol(name.toUtf8().constData()), reinterpret_cast<jl_value_t *>(array));
+    JL_GC_POP();
+
+    return true;
+}
+
+
+
+void SegmentArena::unbind(const QString &name)
+{
+    for (const QString &global : views.value(name)) {
+        jl_set_global(jl_main_module, jl_symbol(global.toUtf8().constData()), jl_nothing);
+    }
+    jl_set_global(jl_main_module, jl_symbol(name.toUtf8().constData()), jl_nothing);
+}
+
+
+
+void SegmentArena::setViews(const QString &name, const QStringList &globals)
+{
+    views[name] = globals;
+}
+
+
+
+qint64 SegmentArena::capacity(const QString &name) const
+{
+    return buffers.value(name).capacity;
+}
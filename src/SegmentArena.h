@@ -0,0 +1,40 @@
+#pragma once
+
+#include <QHash>
+#include <QString>
+#include <QStringList>
+
+// Aligned Float64 buffers owned by the GUI and reused by every segment of a run. Each one is
+// bound to a Julia global as a Vector{Float64} (jl_ptr_to_array_1d, no copy, Julia never frees
+// it); the scripts view it as the nChs x nfrs segment with ArenaMatrix. The globals holding
+// such views are registered with setViews, so a buffer is never freed while Julia can reach it.
+class SegmentArena
+{
+public:
+    // Constructor
+    SegmentArena() = default;
+    ~SegmentArena();
+
+    SegmentArena(const SegmentArena &) = delete;
+    SegmentArena &operator=(const SegmentArena &) = delete;
+
+    // Binds a buffer of at least `elements` doubles to the Julia global `name`
+    bool bind(const QString &name, qint64 elements);
+    void unbind(const QString &name);
+
+    // Julia globals that alias the buffer of `name` (BINRAW, BINPATCH), cleared with it
+    void setViews(const QString &name, const QStringList &globals);
+
+    qint64 capacity(const QString &name) const;
+
+private:
+    struct Buffer {
+        double *data = nullptr;
+        qint64 capacity = 0;
+    };
+
+    static constexpr size_t alignment = 64; // Cache line, also enough for AVX-512
+
+    QHash<QString, Buffer> buffers;
+    QHash<QString, QStringList> views;
+};
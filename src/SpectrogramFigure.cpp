@@ -0,0 +1,241 @@
+#include "SpectrogramFigure.h"
+
+// Project Libraries
+#include <QPainter>
+#include <QPainterPath>
+#include <QFile>
+#include <QDebug>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+// Layout of Channel_Spectrogram: 800x800, four panels one above the other, the series in the first
+// color of the Plots palette
+static const int figureSize = 800;
+static const QColor seriesColor(0, 154, 250);
+
+
+
+bool SpectrogramFigure::write(const QString &seriesPath, const QString &pngPath)
+{
+    QImage image = draw(seriesPath);
+    return !image.isNull() && image.save(pngPath);
+}
+
+
+
+QImage SpectrogramFigure::draw(const QString &seriesPath)
+{
+    Series series;
+    if (!read(seriesPath, series)) {
+        return QImage();
+    }
+
+    QImage image(figureSize, figureSize, QImage::Format_RGB32);
+    image.fill(Qt::white);
+
+    QPainter painter(&image);
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.setRenderHint(QPainter::TextAntialiasing);
+    painter.setFont(QFont("sans-serif", 9));
+
+    int panel = figureSize / 4;
+    double xMax = series.duration;
+
+    // The signal: a vertical line per column, from its minimum to its maximum
+    double lo = std::numeric_limits<double>::infinity();
+    double hi = -lo;
+    extend(series.low, lo, hi);
+    extend(series.high, lo, hi);
+    margins(lo, hi);
+
+    QRect plot = drawAxes(painter, QRect(0, 0, figureSize, panel), QString("Original signal from channel %1").arg(series.channel),
+                          QString::fromUtf8("Amplitude (μV)"), xMax, lo, hi);
+    painter.save();
+    painter.setClipRect(plot);
+    painter.setPen(seriesColor);
+    int columns = series.low.size();
+    for (int c = 0; c < columns; c++) {
+        if (!std::isfinite(series.low[c]) || !std::isfinite(series.high[c])) {
+            continue;
+        }
+        int x = plot.left() + int((c + 0.5) * plot.width() / columns);
+        int y0 = plot.bottom() - int((series.low[c] - lo) / (hi - lo) * plot.height());
+        int y1 = plot.bottom() - int((series.high[c] - lo) / (hi - lo) * plot.height());
+        painter.drawLine(x, y0, x, y1);
+    }
+    painter.restore();
+
+    // The bands, each scaled to its own range as GR does
+    const QVector<double> *bands[3] = { &series.delta, &series.theta, &series.alpha };
+    const char *titles[3] = { "Delta Band (0-5 Hz)", "Theta Band (4-9 Hz)", "Alpha Band (8-12 Hz)" };
+    for (int b = 0; b < 3; b++) {
+        lo = std::numeric_limits<double>::infinity();
+        hi = -lo;
+        extend(*bands[b], lo, hi);
+        margins(lo, hi);
+
+        plot = drawAxes(painter, QRect(0, (b + 1) * panel, figureSize, panel), titles[b], "Normalized Power", xMax, lo, hi);
+        drawCurve(painter, plot, series.time, *bands[b], xMax, lo, hi);
+    }
+
+    return image;
+}
+
+
+
+// Header and sizes checked, a truncated file is not drawn
+bool SpectrogramFigure::read(const QString &path, Series &series)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QByteArray bytes = file.readAll();
+    const char *data = bytes.constData();
+    if (bytes.size() < 40 || std::memcmp(data, "EVALSPG1", 8) != 0) {
+        qDebug() << "Error: Invalid spectrogram series" << path;
+        return false;
+    }
+
+    // Header: 3 Int64 and the duration
+    qint64 ints[3];
+    std::memcpy(ints, data + 8, sizeof(ints));
+    std::memcpy(&series.duration, data + 32, sizeof(double));
+    series.channel = ints[0];
+    qint64 columns = ints[1];
+    qint64 times = ints[2];
+
+    if (columns < 1 || times < 0 || bytes.size() != 40 + qint64(sizeof(double)) * (2 * columns + 4 * times)) {
+        qDebug() << "Error: Truncated spectrogram series" << path;
+        return false;
+    }
+
+    const char *at = data + 40;
+    for (QVector<double> *values : { &series.low, &series.high }) {
+        values->resize(int(columns));
+        std::memcpy(values->data(), at, columns * sizeof(double));
+        at += columns * sizeof(double);
+    }
+    for (QVector<double> *values : { &series.time, &series.delta, &series.theta, &series.alpha }) {
+        values->resize(int(times));
+        std::memcpy(values->data(), at, times * sizeof(double));
+        at += times * sizeof(double);
+    }
+
+    return true;
+}
+
+
+
+// Title, frame, ticks and labels of one panel; the rectangle its data is drawn in
+QRect SpectrogramFigure::drawAxes(QPainter &painter, const QRect &area, const QString &title, const QString &yLabel,
+                                  double xMax, double yMin, double yMax)
+{
+    QRect plot(area.left() + 70, area.top() + 24, area.width() - 90, area.height() - 24 - 40);
+
+    painter.setPen(Qt::black);
+    painter.drawText(QRect(area.left(), area.top(), area.width(), 22), Qt::AlignCenter, title);
+    painter.drawRect(plot);
+
+    // Time, from 0 to the end of the segment
+    double step = tickStep(xMax);
+    for (int i = 0; i * step <= xMax * (1 + 1e-9); i++) {
+        int x = plot.left() + int(i * step / xMax * plot.width());
+        painter.drawLine(x, plot.bottom(), x, plot.bottom() + 4);
+        painter.drawText(QRect(x - 30, plot.bottom() + 5, 60, 14), Qt::AlignHCenter | Qt::AlignTop, QString::number(i * step, 'g', 4));
+    }
+    painter.drawText(QRect(plot.left(), plot.bottom() + 20, plot.width(), 16), Qt::AlignCenter, "Time (s)");
+
+    step = tickStep(yMax - yMin);
+    for (double v = std::ceil(yMin / step) * step; v <= yMax; v += step) {
+        int y = plot.bottom() - int((v - yMin) / (yMax - yMin) * plot.height());
+        painter.drawLine(plot.left() - 4, y, plot.left(), y);
+        painter.drawText(QRect(plot.left() - 54, y - 7, 48, 14), Qt::AlignRight | Qt::AlignVCenter,
+                         QString::number(std::abs(v) < step * 1e-6 ? 0.0 : v, 'g', 3));
+    }
+
+    painter.save();
+    painter.translate(area.left() + 12, plot.center().y());
+    painter.rotate(-90);
+    painter.drawText(QRect(-plot.height() / 2, -8, plot.height(), 16), Qt::AlignCenter, yLabel);
+    painter.restore();
+
+    return plot;
+}
+
+
+
+// A polyline, broken where a value is not finite (a band without variance)
+void SpectrogramFigure::drawCurve(QPainter &painter, const QRect &plot, const QVector<double> &x, const QVector<double> &y,
+                                  double xMax, double yMin, double yMax)
+{
+    QPainterPath path;
+    bool drawing = false;
+    for (int i = 0; i < qMin(x.size(), y.size()); i++) {
+        if (!std::isfinite(x[i]) || !std::isfinite(y[i])) {
+            drawing = false;
+            continue;
+        }
+
+        QPointF point(plot.left() + x[i] / xMax * plot.width(), plot.bottom() - (y[i] - yMin) / (yMax - yMin) * plot.height());
+        if (drawing) {
+            path.lineTo(point);
+        } else {
+            path.moveTo(point);
+            drawing = true;
+        }
+    }
+
+    painter.save();
+    painter.setClipRect(plot);
+    painter.setPen(QPen(seriesColor, 1.5));
+    painter.drawPath(path);
+    painter.restore();
+}
+
+
+
+void SpectrogramFigure::extend(const QVector<double> &values, double &lo, double &hi)
+{
+    for (double v : values) {
+        if (std::isfinite(v)) {
+            lo = qMin(lo, v);
+            hi = qMax(hi, v);
+        }
+    }
+}
+
+
+
+// A little room above and below the data, and a range for flat or empty series
+void SpectrogramFigure::margins(double &lo, double &hi)
+{
+    if (!std::isfinite(lo) || !std::isfinite(hi)) {
+        lo = 0.0;
+        hi = 1.0;
+    } else if (lo == hi) {
+        lo -= 1.0;
+        hi += 1.0;
+    } else {
+        double pad = 0.04 * (hi - lo);
+        lo -= pad;
+        hi += pad;
+    }
+}
+
+
+
+// 1, 2 or 5 times a power of ten, about five ticks over the span
+double SpectrogramFigure::tickStep(double span)
+{
+    if (!(span > 0.0)) {
+        return 1.0;
+    }
+
+    double raw = span / 5.0;
+    double magnitude = std::pow(10.0, std::floor(std::log10(raw)));
+    double norm = raw / magnitude;
+    return (norm < 1.5 ? 1.0 : norm < 3.5 ? 2.0 : norm < 7.5 ? 5.0 : 10.0) * magnitude;
+}
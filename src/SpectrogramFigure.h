@@ -0,0 +1,35 @@
+#pragma once
+
+#include <QImage>
+#include <QString>
+#include <QVector>
+
+class QPainter;
+
+// Native spectrogram figure of one channel, the 800x800 layout Channel_Spectrogram draws with
+// GR: the signal of the segment and the normalized power of the delta, theta and alpha bands
+// over time, one panel each. Drawn from the series SpectrogramSeries writes (<name>.spg, the
+// STFT is Julia's), so neither a click nor the hover prefetch waits for GR.
+class SpectrogramFigure
+{
+public:
+    static bool write(const QString &seriesPath, const QString &pngPath);
+    static QImage draw(const QString &seriesPath);
+
+private:
+    struct Series {
+        qint64 channel = 0;
+        double duration = 0.0;
+        QVector<double> low, high; // Envelope of the signal, one value per column
+        QVector<double> time, delta, theta, alpha;
+    };
+
+    static bool read(const QString &path, Series &series);
+    static QRect drawAxes(QPainter &painter, const QRect &area, const QString &title, const QString &yLabel,
+                          double xMax, double yMin, double yMax);
+    static void drawCurve(QPainter &painter, const QRect &plot, const QVector<double> &x, const QVector<double> &y,
+                          double xMax, double yMin, double yMax);
+    static void extend(const QVector<double> &values, double &lo, double &hi);
+    static void margins(double &lo, double &hi);
+    static double tickStep(double span);
+};
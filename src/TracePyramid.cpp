@@ -0,0 +1,157 @@
+#include "TracePyramid.h"
+
+// Project Libraries
+#include <QDebug>
+#include <cstring>
+
+static_assert(sizeof(TracePyramid::Block) == 12, "Block must match PyramidBlock in AllSTEPs.jl");
+
+
+
+TracePyramid::~TracePyramid()
+{
+    close();
+}
+
+
+
+bool TracePyramid::open(const QString &path)
+{
+    close();
+
+    file.setFileName(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    data = file.map(0, file.size());
+    if (data == nullptr || file.size() < 72 || std::memcmp(data, "EVALPYR1", 8) != 0) {
+        qDebug() << "Error: Invalid pyramid" << path;
+        close();
+        return false;
+    }
+
+    // Header: 5 Int64, 3 Float64 and (blocks, offset) per level
+    qint64 ints[5];
+    double doubles[3];
+    std::memcpy(ints, data + 8, sizeof(ints));
+    std::memcpy(doubles, data + 48, sizeof(doubles));
+
+    nChs = ints[0];
+    nFrames = ints[1];
+    F0 = ints[2];
+    R = ints[3];
+    fs = doubles[0];
+    mvOffset = doubles[1];
+    countsToMV = doubles[2];
+
+    qint64 nLevels = ints[4];
+    if (nLevels < 1 || file.size() < 72 + nLevels * 16) {
+        close();
+        return false;
+    }
+
+    for (qint64 L = 0; L < nLevels; L++) {
+        qint64 level[2];
+        std::memcpy(level, data + 72 + L * 16, sizeof(level));
+        nBlocks.append(level[0]);
+        offsets.append(level[1]);
+    }
+
+    // The last level must end inside the file
+    qint64 end = offsets.last() + nChs * nBlocks.last() * qint64(sizeof(Block));
+    if (end > file.size()) {
+        qDebug() << "Error: Truncated pyramid" << path;
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+
+
+void TracePyramid::close()
+{
+    if (data != nullptr) {
+        file.unmap(data);
+        data = nullptr;
+    }
+
+    file.close();
+    nBlocks.clear();
+    offsets.clear();
+}
+
+
+
+bool TracePyramid::isOpen() const
+{
+    return data != nullptr;
+}
+
+
+
+int TracePyramid::channels() const
+{
+    return int(nChs);
+}
+
+
+
+qint64 TracePyramid::frames() const
+{
+    return nFrames;
+}
+
+
+
+double TracePyramid::samplingRate() const
+{
+    return fs;
+}
+
+
+
+double TracePyramid::toMicroVolts(double code) const
+{
+    return mvOffset + code * countsToMV;
+}
+
+
+
+int TracePyramid::levels() const
+{
+    return nBlocks.size();
+}
+
+
+
+qint64 TracePyramid::blocks(int level) const
+{
+    return nBlocks.value(level, 0);
+}
+
+
+
+qint64 TracePyramid::factor(int level) const
+{
+    qint64 f = F0;
+    for (int L = 0; L < level; L++) {
+        f *= R;
+    }
+
+    return f;
+}
+
+
+
+const TracePyramid::Block *TracePyramid::channel(int level, int ch) const
+{
+    if (data == nullptr || level < 0 || level >= nBlocks.size() || ch < 1 || ch > nChs) {
+        return nullptr;
+    }
+
+    qint64 offset = offsets[level] + (ch - 1) * nBlocks[level] * qint64(sizeof(Block));
+    return reinterpret_cast<const Block *>(data + offset);
+}
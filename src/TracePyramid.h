@@ -0,0 +1,55 @@
+#pragma once
+
+#include <QFile>
+#include <QString>
+#include <QVector>
+
+// Reader of Info/Pyramid.bin, the per-channel min/max/RMS decimation pyramid that STEP00
+// writes (see TracePyramid in AllSTEPs.jl). The file is memory-mapped and every level is
+// channel-major, so one channel at any zoom is a contiguous run of blocks.
+class TracePyramid
+{
+public:
+#pragma pack(push, 1)
+    struct Block {
+        quint16 min;
+        quint16 max;
+        float mean;
+        float rms;
+    };
+#pragma pack(pop)
+
+    // Constructor
+    TracePyramid() = default;
+    ~TracePyramid();
+
+    bool open(const QString &path);
+    void close();
+    bool isOpen() const;
+
+    // Recording properties
+    int channels() const;
+    qint64 frames() const;
+    double samplingRate() const;
+    double toMicroVolts(double code) const;
+
+    // Levels: 0 is the finest
+    int levels() const;
+    qint64 blocks(int level) const;
+    qint64 factor(int level) const;
+    const Block *channel(int level, int ch) const; // ch is 1-based, as in the viewers
+
+private:
+    QFile file;
+    uchar *data = nullptr;
+
+    qint64 nChs = 0;
+    qint64 nFrames = 0;
+    qint64 F0 = 1;
+    qint64 R = 1;
+    double fs = 1.0;
+    double mvOffset = 0.0;
+    double countsToMV = 1.0;
+    QVector<qint64> nBlocks;
+    QVector<qint64> offsets;
+};
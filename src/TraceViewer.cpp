@@ -0,0 +1,307 @@
+#include "TraceViewer.h"
+
+// Project Libraries
+#include <QPainter>
+#include <QPainterPath>
+#include <QMouseEvent>
+#include <QWheelEvent>
+#include <QResizeEvent>
+#include <QDebug>
+#include <julia.h>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
+// Below this many samples per pixel the trace comes from the BRW file
+static const int rawSamplesPerPixel = 4;
+
+
+
+// Constructor
+TraceViewer::TraceViewer(QWidget *parent)
+    : QWidget(parent)
+{
+    setMinimumHeight(160);
+    setMouseTracking(false);
+}
+
+
+
+bool TraceViewer::openPyramid(const QString &path)
+{
+    if (pyramid.isOpen()) {
+        return true;
+    }
+
+    return pyramid.open(path);
+}
+
+
+
+void TraceViewer::showChannel(int newChannel, qint64 firstFrame, qint64 lastFrame)
+{
+    channel = newChannel;
+    rawStart = -1;
+    setView(firstFrame, lastFrame);
+}
+
+
+
+void TraceViewer::clear()
+{
+    channel = 0;
+    rawSamples.clear();
+    rawStart = -1;
+    pyramid.close();
+    update();
+}
+
+
+
+void TraceViewer::setView(qint64 start, qint64 end)
+{
+    qint64 frames = pyramid.frames();
+    qint64 span = qBound<qint64>(16, end - start, qMax<qint64>(16, frames));
+
+    start = qBound<qint64>(0, start, qMax<qint64>(0, frames - span));
+    viewStart = start;
+    viewEnd = start + span;
+    refreshRaw();
+    update();
+}
+
+
+
+void TraceViewer::setScheduler(JobScheduler *jobScheduler)
+{
+    scheduler = jobScheduler;
+}
+
+
+
+// Zoomed in, the samples of the view are read once here; meanwhile the pyramid is drawn
+void TraceViewer::refreshRaw()
+{
+    if (channel == 0 || viewEnd - viewStart > qint64(width()) * rawSamplesPerPixel) {
+        return;
+    }
+    if (scheduler != nullptr && scheduler->isBatchRunning()) {
+        return;
+    }
+
+    loadRaw(viewStart, viewEnd);
+}
+
+
+
+bool TraceViewer::hasRaw() const
+{
+    return rawChannel == channel && rawStart == viewStart && rawSamples.size() == viewEnd - viewStart;
+}
+
+
+
+// Coarsest level that still gives at least one block per pixel
+int TraceViewer::levelFor(qint64 span) const
+{
+    int level = 0;
+    for (int L = 1; L < pyramid.levels(); L++) {
+        if (span / pyramid.factor(L) >= width()) {
+            level = L;
+        }
+    }
+
+    return level;
+}
+
+
+
+// Streams the visible window of the channel, never the whole channel
+bool TraceViewer::loadRaw(qint64 start, qint64 end)
+{
+    if (rawChannel == channel && rawStart == start && rawSamples.size() == end - start) {
+        return true;
+    }
+    rawSamples.clear();
+
+    QString evalString = QString("traceSamples = TraceSamples( Variables, %1, %2, %3 );")
+                             .arg(channel).arg(start + 1).arg(end);
+    jl_eval_string(evalString.toUtf8().constData());
+
+    if (jl_exception_occurred()) {
+        qDebug() << "Error: Trace not read from the BRW file";
+        return false;
+    }
+
+    // The global keeps the array alive while it is copied
+    jl_value_t *length = jl_eval_string("length( traceSamples )");
+    jl_value_t *address = jl_eval_string("UInt( pointer( traceSamples ) )");
+    qint64 n = jl_unbox_int64(length);
+    const float *samples = reinterpret_cast<const float *>(jl_unbox_uint64(address));
+
+    rawSamples = QVector<float>(samples, samples + n);
+    rawStart = start;
+    rawChannel = channel;
+    return true;
+}
+
+
+
+void TraceViewer::paintEvent(QPaintEvent *event)
+{
+    Q_UNUSED(event);
+
+    QPainter painter(this);
+    painter.fillRect(rect(), Qt::white);
+    painter.setPen(Qt::gray);
+    painter.drawRect(rect().adjusted(0, 0, -1, -1));
+
+    if (!pyramid.isOpen() || channel == 0) {
+        painter.drawText(rect(), Qt::AlignCenter, "Click a channel to see its trace");
+        return;
+    }
+
+    const int w = width();
+    const int h = height() - 16;
+    const qint64 span = viewEnd - viewStart;
+
+    // Per pixel column: min, max, mean and rms in μV
+    QVector<double> colMin(w, std::numeric_limits<double>::max());
+    QVector<double> colMax(w, std::numeric_limits<double>::lowest());
+    QVector<double> colMean(w, 0.0);
+    QVector<double> colRms(w, 0.0);
+    bool raw = span <= qint64(w) * rawSamplesPerPixel && hasRaw();
+
+    if (raw) {
+        for (int x = 0; x < w; x++) {
+            qint64 i0 = span * x / w;
+            qint64 i1 = qMax(i0 + 1, span * (x + 1) / w);
+            for (qint64 i = i0; i < i1 && i < rawSamples.size(); i++) {
+                colMin[x] = qMin(colMin[x], double(rawSamples[i]));
+                colMax[x] = qMax(colMax[x], double(rawSamples[i]));
+            }
+            colMean[x] = (colMin[x] + colMax[x]) / 2.0;
+        }
+    } else {
+        int level = levelFor(span);
+        qint64 f = pyramid.factor(level);
+        qint64 nb = pyramid.blocks(level);
+        const TracePyramid::Block *blocks = pyramid.channel(level, channel);
+
+        if (blocks == nullptr) {
+            return;
+        }
+
+        for (int x = 0; x < w; x++) {
+            qint64 b0 = (viewStart + span * x / w) / f;
+            qint64 b1 = qMax(b0 + 1, (viewStart + span * (x + 1) / w) / f);
+            b1 = qMin(b1, nb);
+
+            int count = 0;
+            for (qint64 b = b0; b < b1; b++, count++) {
+                colMin[x] = qMin(colMin[x], double(blocks[b].min));
+                colMax[x] = qMax(colMax[x], double(blocks[b].max));
+                colMean[x] += blocks[b].mean;
+                colRms[x] += blocks[b].rms;
+            }
+
+            if (count > 0) {
+                // Codes to μV; an inverted signal swaps the extremes
+                double a = pyramid.toMicroVolts(colMin[x]);
+                double b = pyramid.toMicroVolts(colMax[x]);
+                colMin[x] = qMin(a, b);
+                colMax[x] = qMax(a, b);
+                colMean[x] = pyramid.toMicroVolts(colMean[x] / count);
+                colRms[x] = std::abs(pyramid.toMicroVolts(colRms[x] / count) - pyramid.toMicroVolts(0.0));
+            }
+        }
+    }
+
+    // Vertical scale from the visible data
+    double lo = std::numeric_limits<double>::max();
+    double hi = std::numeric_limits<double>::lowest();
+    for (int x = 0; x < w; x++) {
+        if (colMin[x] <= colMax[x]) {
+            lo = qMin(lo, colMin[x]);
+            hi = qMax(hi, colMax[x]);
+        }
+    }
+
+    if (lo >= hi) {
+        hi = lo + 1.0;
+    }
+
+    auto toY = [=](double v) { return int(h - (v - lo) / (hi - lo) * (h - 4) - 2); };
+
+    for (int x = 0; x < w; x++) {
+        if (colMin[x] > colMax[x]) {
+            continue;
+        }
+
+        if (!raw) {
+            painter.setPen(QColor(120, 160, 220));
+            painter.drawLine(x, toY(colMean[x] - colRms[x]), x, toY(colMean[x] + colRms[x]));
+        }
+
+        painter.setPen(QColor(20, 60, 140));
+        painter.drawLine(x, toY(colMin[x]), x, toY(colMax[x]));
+    }
+
+    // Labels
+    double fs = pyramid.samplingRate();
+    painter.setPen(Qt::black);
+    painter.drawText(4, height() - 3, QString::number(viewStart / fs, 'f', 3) + " s");
+    painter.drawText(rect().adjusted(0, 0, -4, -3), Qt::AlignRight | Qt::AlignBottom,
+                     QString::number(viewEnd / fs, 'f', 3) + " s");
+    painter.drawText(rect().adjusted(0, 2, 0, 0), Qt::AlignHCenter | Qt::AlignTop,
+                     QString("Channel %1 | %2 μV").arg(channel).arg(hi - lo, 0, 'f', 1));
+}
+
+
+
+void TraceViewer::resizeEvent(QResizeEvent *event)
+{
+    QWidget::resizeEvent(event);
+    refreshRaw(); // The width decides when the samples are read
+}
+
+
+
+// Zoom around the cursor
+void TraceViewer::wheelEvent(QWheelEvent *event)
+{
+    if (channel == 0) {
+        return;
+    }
+
+    double factor = event->angleDelta().y() > 0 ? 0.8 : 1.25;
+    double anchor = double(event->position().x()) / qMax(1, width());
+    qint64 span = viewEnd - viewStart;
+    qint64 center = viewStart + qint64(span * anchor);
+    qint64 newSpan = qint64(span * factor);
+
+    setView(center - qint64(newSpan * anchor), center - qint64(newSpan * anchor) + newSpan);
+}
+
+
+
+void TraceViewer::mousePressEvent(QMouseEvent *event)
+{
+    dragX = event->x();
+}
+
+
+
+// Drag to pan
+void TraceViewer::mouseMoveEvent(QMouseEvent *event)
+{
+    if (!(event->buttons() & Qt::LeftButton) || dragX < 0) {
+        return;
+    }
+
+    qint64 span = viewEnd - viewStart;
+    qint64 shift = qint64(double(dragX - event->x()) / qMax(1, width()) * span);
+    dragX = event->x();
+
+    setView(viewStart + shift, viewEnd + shift);
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <QWidget>
+#include <QVector>
+#include "TracePyramid.h"
+#include "JobScheduler.h"
+
+// Raw voltage trace of one channel. Zoomed out it draws the min/max envelope and the RMS
+// band from the pyramid level that matches the widget width; zoomed in to a few samples per
+// pixel it streams just the visible window of the channel from the BRW file through Julia,
+// when the channel or the view changes (never while painting, nor while a batch runs).
+class TraceViewer : public QWidget
+{
+    Q_OBJECT
+
+public:
+    // Constructor
+    TraceViewer(QWidget *parent = nullptr);
+
+    // My public functions
+    bool openPyramid(const QString &path);
+    void showChannel(int channel, qint64 firstFrame, qint64 lastFrame);
+    void clear();
+    void setScheduler(JobScheduler *jobScheduler);
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void wheelEvent(QWheelEvent *event) override;
+    void mousePressEvent(QMouseEvent *event) override;
+    void mouseMoveEvent(QMouseEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+
+private:
+    TracePyramid pyramid;
+
+    int channel = 0;
+    qint64 viewStart = 0; // Frames, 0-based, end exclusive
+    qint64 viewEnd = 0;
+    int dragX = -1;
+
+    // Full resolution window, only when zoomed in
+    QVector<float> rawSamples;
+    qint64 rawStart = -1;
+    int rawChannel = 0;
+
+    // Julia is not entered while the kernels of a batch run
+    JobScheduler *scheduler = nullptr;
+
+    int levelFor(qint64 span) const;
+    bool loadRaw(qint64 start, qint64 end);
+    bool hasRaw() const;
+    void refreshRaw();
+    void setView(qint64 start, qint64 end);
+};
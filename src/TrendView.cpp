@@ -0,0 +1,375 @@
+#include "TrendView.h"
+
+// Project Libraries
+#include <QPainter>
+#include <QMouseEvent>
+#include <QDebug>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
+// Color limits of the global z-score, as the ± 2 of Zplot
+static const double trendLimit = 2.0;
+
+
+
+// Constructor
+TrendView::TrendView(QWidget *parent)
+    : QWidget(parent)
+{
+    setMinimumHeight(120);
+
+    // Gray ramp until a colorbar is set
+    for (int i = 0; i < 256; i++) {
+        palette.append(qRgb(i, i, i));
+    }
+}
+
+
+
+void TrendView::Stats::add(double t, double x)
+{
+    n += 1.0;
+    double dt = t - meanT;
+    double dx = x - meanX;
+    meanT += dt / n;
+    meanX += dx / n;
+    m2T += dt * (t - meanT);
+    m2X += dx * (x - meanX);
+    coTX += dt * (x - meanX);
+}
+
+// The inverse of add, exact back to zero once the last value is gone
+void TrendView::Stats::remove(double t, double x)
+{
+    if (n <= 1.0) {
+        *this = Stats();
+        return;
+    }
+
+    n -= 1.0;
+    double dt = t - meanT;
+    double dx = x - meanX;
+    meanT -= dt / n;
+    meanX -= dx / n;
+    m2T -= dt * (t - meanT);
+    m2X -= dx * (x - meanX);
+    coTX -= dt * (x - meanX);
+}
+
+double TrendView::Stats::mean() const
+{
+    return n > 0.0 ? meanX : std::numeric_limits<double>::quiet_NaN();
+}
+
+double TrendView::Stats::variance() const
+{
+    if (n < 2.0) {
+        return 0.0;
+    }
+    return qMax(0.0, m2X / (n - 1.0));
+}
+
+// Least squares slope of the metric over the segment index
+double TrendView::Stats::slope() const
+{
+    return m2T > 0.0 ? coTX / m2T : 0.0;
+}
+
+
+
+void TrendView::reset(int channels, int segments)
+{
+    nChs = qMax(0, channels);
+    N = qMax(0, segments);
+
+    for (Metric &m : metrics) {
+        m.values.assign(size_t(nChs) * size_t(N), std::numeric_limits<double>::quiet_NaN());
+        m.stats.assign(size_t(nChs), Stats());
+        m.global = Stats();
+    }
+
+    updateRows();
+}
+
+
+
+int TrendView::channels() const
+{
+    return nChs;
+}
+
+
+
+// More (or fewer) segments, the columns already set are kept
+void TrendView::setSegments(int segments)
+{
+    N = qMax(0, segments);
+    for (Metric &m : metrics) {
+        m.values.resize(size_t(nChs) * size_t(N), std::numeric_limits<double>::quiet_NaN());
+    }
+
+    dirty = true;
+    update();
+}
+
+
+
+void TrendView::clear()
+{
+    reset(0, 0);
+}
+
+
+
+// Only this column changes, the values it replaces are removed from the moments as they were added
+void TrendView::setColumn(MapAtlas::Layer layer, int segment, const double *values)
+{
+    if (segment < 0 || segment >= N || values == nullptr) {
+        return;
+    }
+
+    Metric &m = metrics[layer];
+    double *column = m.values.data() + size_t(segment) * size_t(nChs);
+    double t = segment;
+
+    for (int ch = 0; ch < nChs; ch++) {
+        if (std::isfinite(column[ch])) {
+            m.stats[ch].remove(t, column[ch]);
+            m.global.remove(t, column[ch]);
+        }
+        if (std::isfinite(values[ch])) {
+            m.stats[ch].add(t, values[ch]);
+            m.global.add(t, values[ch]);
+        }
+        column[ch] = values[ch];
+    }
+
+    // Sorting by statistics may move every row
+    if (sortOrder != ByChannel) {
+        updateRows();
+    } else {
+        dirty = true;
+        update();
+    }
+}
+
+
+
+void TrendView::load(const ResultsStore &store)
+{
+    reset(store.channels(), store.segments());
+
+    for (int s = 0; s < N; s++) {
+        setColumn(MapAtlas::Cardinality, s, store.column("Cardinality", s));
+        setColumn(MapAtlas::VoltageShiftDeviation, s, store.column("VoltageShiftDeviation", s));
+    }
+
+    updateRows();
+}
+
+
+
+void TrendView::setMetric(MapAtlas::Layer layer)
+{
+    metric = layer;
+    updateRows();
+}
+
+
+
+void TrendView::setSortOrder(SortOrder order)
+{
+    sortOrder = order;
+    updateRows();
+}
+
+
+
+// Rectangle of the 64x64 array, empty for every channel
+void TrendView::setRoi(const QRect &newRoi)
+{
+    roi = newRoi.normalized();
+    updateRows();
+}
+
+
+
+void TrendView::setColorbar(const QImage &colorbar)
+{
+    if (colorbar.isNull()) {
+        return;
+    }
+
+    QImage bar = colorbar.convertToFormat(QImage::Format_RGB32);
+    const QRgb *barLine = reinterpret_cast<const QRgb *>(bar.constScanLine(bar.height() / 2));
+
+    palette.clear();
+    for (int i = 0; i < 256; i++) {
+        palette.append(barLine[i * (bar.width() - 1) / 255]);
+    }
+
+    dirty = true;
+    update();
+}
+
+
+
+void TrendView::updateRows()
+{
+    int side = int(std::lround(std::sqrt(double(nChs))));
+    rows.clear();
+
+    for (int ch = 0; ch < nChs; ch++) {
+        if (roi.isEmpty() || side * side != nChs || roi.contains(ch % side, ch / side)) {
+            rows.append(ch);
+        }
+    }
+
+    if (sortOrder != ByChannel) {
+        QVector<double> key(nChs, 0.0);
+        for (int ch : rows) {
+            const Stats &s = metrics[metric].stats[ch];
+            double k = (sortOrder == ByMean) ? s.mean() : (sortOrder == ByVariance) ? s.variance() : s.slope();
+            key[ch] = std::isfinite(k) ? k : std::numeric_limits<double>::lowest();
+        }
+
+        // Largest first, channels not evaluated at the bottom
+        std::stable_sort(rows.begin(), rows.end(), [&key](int a, int b) { return key[a] > key[b]; });
+    }
+
+    dirty = true;
+    update();
+}
+
+
+
+QRect TrendView::matrixRect() const
+{
+    return rect().adjusted(1, 16, -1, -1);
+}
+
+
+
+// One pixel per segment and per row bin, the bins average their channels
+void TrendView::render()
+{
+    dirty = false;
+    QRect area = matrixRect();
+    int nRows = rows.size();
+
+    if (N == 0 || nRows == 0 || area.height() <= 0) {
+        image = QImage();
+        return;
+    }
+
+    int H = qMin(nRows, area.height());
+    const Metric &m = metrics[metric];
+    double mean = m.global.mean();
+    double sd = std::sqrt(m.global.variance());
+    if (!(sd > 0.0)) {
+        sd = 1.0;
+    }
+
+    image = QImage(N, H, QImage::Format_RGB32);
+    for (int b = 0; b < H; b++) {
+        int r0 = int(qint64(b) * nRows / H);
+        int r1 = qMax(r0 + 1, int(qint64(b + 1) * nRows / H));
+        QRgb *line = reinterpret_cast<QRgb *>(image.scanLine(b));
+
+        for (int s = 0; s < N; s++) {
+            const double *column = m.values.data() + size_t(s) * size_t(nChs);
+            double acc = 0.0;
+            int count = 0;
+            for (int r = r0; r < r1; r++) {
+                double v = column[rows[r]];
+                if (std::isfinite(v)) {
+                    acc += v;
+                    count++;
+                }
+            }
+
+            if (count == 0) {
+                line[s] = qRgb(255, 255, 255); // Not evaluated yet
+                continue;
+            }
+
+            double z = (acc / count - mean) / sd;
+            double t = (qBound(-trendLimit, z, trendLimit) + trendLimit) / (2.0 * trendLimit);
+            line[s] = palette[int(t * 255.0)];
+        }
+    }
+}
+
+
+
+void TrendView::paintEvent(QPaintEvent *event)
+{
+    Q_UNUSED(event);
+
+    QPainter painter(this);
+    painter.fillRect(rect(), Qt::white);
+    painter.setPen(Qt::gray);
+    painter.drawRect(rect().adjusted(0, 0, -1, -1));
+
+    if (N == 0) {
+        painter.drawText(rect(), Qt::AlignCenter, "Evaluate or load a recording to see the trend");
+        return;
+    }
+
+    if (dirty) {
+        render();
+    }
+
+    static const char *sortNames[] = { "channel", "mean", "variance", "slope" };
+    QString title = QString("%1 x %2 segments, sorted by %3%4")
+                        .arg(rows.size()).arg(N).arg(sortNames[sortOrder])
+                        .arg(roi.isEmpty() ? QString() : QString(", ROI"));
+    painter.setPen(Qt::black);
+    painter.drawText(rect().adjusted(4, 1, -4, 0), Qt::AlignLeft | Qt::AlignTop, title);
+
+    if (!image.isNull()) {
+        painter.drawImage(matrixRect(), image); // Nearest neighbour, cells stay sharp
+    }
+}
+
+
+
+void TrendView::resizeEvent(QResizeEvent *event)
+{
+    dirty = true;
+    QWidget::resizeEvent(event);
+}
+
+
+
+// The channel of the clicked bin that stands out the most in that segment
+void TrendView::mousePressEvent(QMouseEvent *event)
+{
+    QRect area = matrixRect();
+    if (N == 0 || rows.isEmpty() || image.isNull() || !area.contains(event->pos())) {
+        return;
+    }
+
+    int s = qBound(0, (event->x() - area.x()) * N / area.width(), N - 1);
+    int H = image.height();
+    int b = qBound(0, (event->y() - area.y()) * H / area.height(), H - 1);
+    int nRows = rows.size();
+    int r0 = int(qint64(b) * nRows / H);
+    int r1 = qMax(r0 + 1, int(qint64(b + 1) * nRows / H));
+
+    const Metric &m = metrics[metric];
+    const double *column = m.values.data() + size_t(s) * size_t(nChs);
+    double mean = m.global.mean();
+    int best = rows[r0];
+    double bestDev = -1.0;
+    for (int r = r0; r < r1; r++) {
+        double v = column[rows[r]];
+        if (std::isfinite(v) && std::abs(v - mean) > bestDev) {
+            bestDev = std::abs(v - mean);
+            best = rows[r];
+        }
+    }
+
+    emit cellSelected(s, best + 1);
+}
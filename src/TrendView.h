@@ -0,0 +1,80 @@
+#pragma once
+
+#include <QWidget>
+#include <QImage>
+#include <QRect>
+#include <QVector>
+#include <vector>
+#include "MapAtlas.h"
+#include "ResultsStore.h"
+
+// Channel x segment matrix of one metric (Cardinality or VoltageShiftDeviation), one column
+// per segment, filled as each segment finishes or from the results store. Rows can be sorted
+// by per-channel statistics kept incrementally (mean, variance, slope over the segments) and
+// restricted to a rectangular ROI of the array. When there are more rows than pixels, each
+// pixel row averages its channels; clicking a cell selects its most deviant channel.
+class TrendView : public QWidget
+{
+    Q_OBJECT
+
+public:
+    enum SortOrder { ByChannel, ByMean, ByVariance, BySlope };
+
+    // Constructor
+    TrendView(QWidget *parent = nullptr);
+
+    // My public functions
+    void reset(int channels, int segments);
+    void setSegments(int segments);
+    int channels() const;
+    void setColumn(MapAtlas::Layer metric, int segment, const double *values);
+    void load(const ResultsStore &store);
+    void clear();
+
+    void setMetric(MapAtlas::Layer metric);
+    void setSortOrder(SortOrder order);
+    void setRoi(const QRect &roi);
+    void setColorbar(const QImage &colorbar);
+
+signals:
+    void cellSelected(int segment, int channel); // 0-based segment, 1-based channel
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void mousePressEvent(QMouseEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+
+private:
+    // Running moments over the evaluated segments of one channel (Welford), a value is added
+    // and removed again when its column is replaced
+    struct Stats {
+        double n = 0.0, meanX = 0.0, meanT = 0.0, m2X = 0.0, m2T = 0.0, coTX = 0.0;
+        void add(double t, double x);
+        void remove(double t, double x);
+        double mean() const;
+        double variance() const;
+        double slope() const;
+    };
+
+    struct Metric {
+        std::vector<double> values; // nChs x N, NaN until evaluated; what the moments hold
+        std::vector<Stats> stats;
+        Stats global;
+    };
+
+    void updateRows();
+    void render();
+    QRect matrixRect() const;
+
+    int nChs = 0;
+    int N = 0;
+    Metric metrics[2];
+    MapAtlas::Layer metric = MapAtlas::Cardinality;
+    SortOrder sortOrder = ByChannel;
+    QRect roi;
+
+    QVector<int> rows;     // Channels shown, 0-based, in display order
+    QVector<QRgb> palette; // 256 colors sampled from the colorbar
+    QImage image;          // One pixel per segment and row bin
+    bool dirty = true;
+};
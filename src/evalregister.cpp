@@ -3,6 +3,7 @@
 
 // Project Libraries
 #include <QFileDialog>
+#include <QCloseEvent>
 #include <QProgressDialog>
 #include <QDesktopServices>
 #include <QStandardPaths>
@@ -10,15 +11,33 @@
 #include <QSettings>
 #include <QSpinBox>
 #include <QSlider>
+#include <QScreen>
+#include <QSignalBlocker>
+#include <QInputDialog>
 #include <QTimer>
+#include <QThread>
+#include <QEventLoop>
+#include <QElapsedTimer>
+#include <QVBoxLayout>
 #include <QString>
 #include <QDebug>
 #include <QDir>
 #include <QUrl>
 #include <julia.h>
+#include "RecordingCache.h"
+#include "ArtifactCache.h"
+#include "FigureExport.h"
 
 JULIA_DEFINE_FAST_TLS  // Julia goes brrrrr....
 
+// Follow mode: ms between checks of the recording length, and without growth before it ends
+static const int followInterval = 500;
+static const int followIdle = 60000;
+
+// What a STEP00 run writes to Info/, kept (and put back) by the artifact cache
+static const QStringList step00InfoFiles = { "STEP00.res", "DELTA.res", "THETA.res", "ALPHA.res", "SPIKES.res", "CONNECTIVITY.res",
+                                             "Variables.jld2", "Parameters.jld2", "Memory.jld2", "BANDS.jld2", "SPIKES.jld2", "Sketch.bin", "Pyramid.bin" };
+
 // Constructor
 evalRegister::evalRegister(QWidget *parent)
     : QMainWindow(parent), ui(new Ui::evalRegister)
@@ -28,35 +47,87 @@ evalRegister::evalRegister(QWidget *parent)
     figureViewer = new FigureViewer(ui->figureViewerWidget);
     figureViewer_STD = new FigureViewer(ui->figureViewer2);
 
+    figureViewer->setScheduler(&scheduler);
+    figureViewer_STD->setScheduler(&scheduler);
+
+    traceViewer = new TraceViewer(ui->traceViewerWidget);
+    traceViewer->setScheduler(&scheduler);
+    QVBoxLayout *traceLayout = new QVBoxLayout(ui->traceViewerWidget);
+    traceLayout->setContentsMargins(0, 0, 0, 0);
+    traceLayout->addWidget(traceViewer);
+
+    trendView = new TrendView(ui->trendViewerWidget);
+    QVBoxLayout *trendLayout = new QVBoxLayout(ui->trendViewerWidget);
+    trendLayout->setContentsMargins(0, 0, 0, 0);
+    trendLayout->addWidget(trendView);
+
+    // The Raw Bin Behavior chart covers the spectrogram until one is shown
+    behaviorChart = new BehaviorChart(ui->imgLabel);
+    QVBoxLayout *behaviorLayout = new QVBoxLayout(ui->imgLabel);
+    behaviorLayout->setContentsMargins(0, 0, 0, 0);
+    behaviorLayout->addWidget(behaviorChart);
+    behaviorChart->hide();
+
     // Julia libraries
     system("julia -e \"include(\\\"./methods/DEPS_01.jl\\\");\""); // & pause");
 
-    // Initializing Julia
+    // Initializing Julia, its threads are the pool of every per-channel kernel (ForChannels). No
+    // project is open yet, so they are set by the config.ini next to the executable
+    QSettings poolSettings(QCoreApplication::applicationDirPath() + "/config.ini", QSettings::IniFormat);
+    if (!qEnvironmentVariableIsSet("JULIA_NUM_THREADS")) {
+        int threads = poolSettings.value("threads", QThread::idealThreadCount()).toInt();
+        qputenv("JULIA_NUM_THREADS", QByteArray::number(qMax(1, threads)));
+    }
+    if (poolSettings.value("pinThreads", false).toBool()) {
+        qputenv("JULIA_EXCLUSIVE", "1"); // One thread per core, pinned
+    }
     jl_init();
     jl_eval_string("println(\"Julia initialized...\");");
 
+    // The segment globals are views of the arena, dropped with it when a buffer grows
+    arena.setViews("ARENA_RAW", { "BINRAW" });
+    arena.setViews("ARENA_PATCH", { "BINPATCH" });
+
     // Color Schemes
     QStringList colorSchemes = { "vik", "blues", "bluesreds", "grays", "greens", "heat", "reds", "redsblues", "algae", "amp", "matter", "inferno" };
     ui->labelCbar->setPixmap(QPixmap(QString(QCoreApplication::applicationDirPath() + "/resources/cbar/vik.png")).scaled(ui->imgLabel->size(), Qt::KeepAspectRatioByExpanding, Qt::SmoothTransformation));
     ui->colorComboBox->addItems(colorSchemes);
 
     // Type of Graph
-    QStringList typeOfGraphs = { "STEP00", "STEP01" }; // , "ACD", "STEP02" };
+    QStringList typeOfGraphs = { "STEP00", "STEP01", "DELTA", "THETA", "ALPHA", "SPIKES", "CONNECTIVITY", "REBIN" }; // , "ACD", "STEP02" };
     ui->typeOfGraphComboBox->addItems(typeOfGraphs);
 
+    // Filter bank
+    ui->filterComboBox->addItems({ "None", "Bandpass", "Notch" });
+
+    // Trend view, in the order of MapAtlas::Layer and TrendView::SortOrder
+    ui->trendMetricComboBox->addItems({ "Cardinality", "VoltageShiftDeviation" });
+    ui->trendSortComboBox->addItems({ "Channel", "Mean", "Variance", "Slope" });
+    trendView->setColorbar(QImage(QCoreApplication::applicationDirPath() + "/resources/cbar/vik.png"));
+
     // Definning Slots...
     connect(ui->actionOpen, &QAction::triggered, this, &evalRegister::actionOpenTriggered); // Open
     connect(ui->actionLoad, &QAction::triggered, this, &evalRegister::actionLoadTriggered); // Load
+    connect(ui->actionCompare, &QAction::triggered, this, &evalRegister::actionCompareTriggered); // Compare
     connect(ui->actionExit, &QAction::triggered, this, &evalRegister::actionExitTriggered); // Exit
     connect(ui->myComboBox, &QComboBox::currentTextChanged, this, &evalRegister::ComboBoxCurrentTextChanged);
     connect(ui->typeOfGraphComboBox, &QComboBox::currentTextChanged, this, &evalRegister::typeOfGraphComboBoxTextChanged);
     connect(ui->colorComboBox, &QComboBox::currentTextChanged, this, &evalRegister::colorComboBoxTextChanged);
     connect(ui->buttonEvaluate, &QPushButton::clicked, this, &evalRegister::ButtonEvaluateClicked);
     connect(ui->buttonBinBehaviour, &QPushButton::clicked, this, &evalRegister::ButtonBinBehavior);
+    connect(ui->buttonRebin, &QPushButton::clicked, this, &evalRegister::ButtonRebinClicked);
     connect(ui->buttonStep01, &QPushButton::clicked, this, &evalRegister::ButtonStep01Clicked);
     connect(ui->buttonExplorer, &QPushButton::clicked, this, &evalRegister::ButtonOpenExplorer);
     connect(ui->spinBoxN1, qOverload<int>(&QSpinBox::valueChanged), this, &evalRegister::SpinBoxN1ValueChanged);
     connect(ui->spinBoxN_overlap, qOverload<int>(&QSpinBox::valueChanged), this, &evalRegister::SpinBoxNoverLapValueChanged);
+    connect(ui->segmentSlider, &QSlider::valueChanged, this, &evalRegister::SegmentSliderValueChanged);
+    connect(ui->buttonPlay, &QPushButton::clicked, this, &evalRegister::ButtonPlayClicked);
+    connect(ui->filterComboBox, &QComboBox::currentTextChanged, this, &evalRegister::filterComboBoxTextChanged);
+
+    // Time-lapse playback of the segments
+    playTimer = new QTimer(this);
+    playTimer->setTimerType(Qt::PreciseTimer);
+    connect(playTimer, &QTimer::timeout, this, &evalRegister::PlayTimerTimeout);
 
     ui->maxGBSlider->setRange(ui->maxGBSpinBox->minimum() * scaleFactor, ui->maxGBSpinBox->maximum() * scaleFactor);
 
@@ -72,6 +143,24 @@ evalRegister::evalRegister(QWidget *parent)
     // Foreign Slots...
     connect(figureViewer, &FigureViewer::filenameChanged, this, &evalRegister::setSpectro); // I love this <3
     connect(figureViewer_STD, &FigureViewer::filenameChanged, this, &evalRegister::setSpectro);
+    connect(figureViewer, &FigureViewer::channelSelected, this, &evalRegister::showTrace);
+    connect(figureViewer_STD, &FigureViewer::channelSelected, this, &evalRegister::showTrace);
+    connect(figureViewer, &FigureViewer::prefetchRequested, this, &evalRegister::prepareSpec);
+    connect(figureViewer_STD, &FigureViewer::prefetchRequested, this, &evalRegister::prepareSpec);
+    connect(figureViewer, &FigureViewer::roiSelected, this, &evalRegister::roiSelected);
+    connect(figureViewer_STD, &FigureViewer::roiSelected, this, &evalRegister::roiSelected);
+    connect(trendView, &TrendView::cellSelected, this, &evalRegister::trendCellSelected);
+    connect(behaviorChart, &BehaviorChart::segmentSelected, [=](int segment) {
+        if (segment < ui->myComboBox->count()) {
+            ui->myComboBox->setCurrentIndex(segment);
+        }
+    });
+    connect(ui->trendMetricComboBox, qOverload<int>(&QComboBox::currentIndexChanged), [=](int index) {
+        trendView->setMetric(MapAtlas::Layer(index));
+    });
+    connect(ui->trendSortComboBox, qOverload<int>(&QComboBox::currentIndexChanged), [=](int index) {
+        trendView->setSortOrder(TrendView::SortOrder(index));
+    });
 
     // Freign Anonymous Signals and Slots
     connect(figureViewer, &FigureViewer::currentChannelChanged, [=](int value) {
@@ -105,8 +194,35 @@ void evalRegister::actionExitTriggered() { close(); }
 
 
 
+// Recordings evaluated before are shown next to the current one, from their stored results
+void evalRegister::actionCompareTriggered()
+{
+    if (compareWindow == nullptr) {
+        QStringList steps;
+        for (int i = 0; i < ui->typeOfGraphComboBox->count(); i++) {
+            steps.append(ui->typeOfGraphComboBox->itemText(i));
+        }
+        compareWindow = new CompareWindow(steps, this);
+    }
+
+    if (!FILEBRW.isEmpty() && RecordingCache::hasResults(mainPath)) {
+        compareWindow->addRecording(FILEBRW);
+    }
+
+    compareWindow->show();
+    compareWindow->raise();
+    compareWindow->activateWindow();
+}
+
+
+
 void evalRegister::actionOpenTriggered()
 {
+    // One batch at a time, clicks on the maps are the only work allowed meanwhile
+    if (scheduler.isBatchRunning()) {
+        return;
+    }
+
     // Ensure that brwPath.txt is saved in
     if (QDir::currentPath() != QCoreApplication::applicationDirPath()) {
         QDir::setCurrent(QCoreApplication::applicationDirPath());
@@ -148,6 +264,8 @@ void evalRegister::actionOpenTriggered()
             QMessageBox::Yes | QMessageBox::No);
 
         if (reply == QMessageBox::Yes) {
+            closeAtlases();
+            traceViewer->clear();
             ui->myComboBox->clear();
             figureViewer->clear();
             figureViewer_STD->clear();
@@ -181,6 +299,11 @@ void evalRegister::actionOpenTriggered()
 
 void evalRegister::actionLoadTriggered()
 {
+    // One batch at a time, clicks on the maps are the only work allowed meanwhile
+    if (scheduler.isBatchRunning()) {
+        return;
+    }
+
     // Ensure that brwPath.txt is saved in
     if (QDir::currentPath() != QCoreApplication::applicationDirPath()) {
         QDir::setCurrent(QCoreApplication::applicationDirPath());
@@ -241,36 +364,42 @@ void evalRegister::actionLoadTriggered()
 
     // Some auxiliar functions
     loadFromIni();
+    closeAtlases();
+
+    // Found again by its contents if the BRW is moved or copied
+    recordingId = RecordingCache::fingerprint(FILEBRW);
+    FigureViewer::setRecording(recordingId);
+    RecordingCache::remember(recordingId, mainPath);
+    traceViewer->clear();
     figuresPath("STEP00");
     ui->typeOfGraphComboBox->setEnabled(true);
 
-    // Load code for Spectrograms
-    evalJuliaString("PATHINFO", infoPath);
-
-    // Julia Callings
-    QDir::setCurrent(QCoreApplication::applicationDirPath());
-    jl_eval_string("cd(\"methods/\");");
-    jl_eval_string("include(\"CODE_SPEC.jl\");");
+    // The code for Spectrograms is loaded on the first click, restoring needs no Julia
+    specLoaded = false;
 
-    // Enabling buttons...
-    ui->buttonStep01->setEnabled(true);
+    // Enabling buttons... (not the steps built on a full STEP00 after a quick look)
+    bool preview = previewOnly();
+    ui->buttonStep01->setEnabled(!preview);
     ui->buttonExplorer->setEnabled(true);
     ui->buttonBinBehaviour->setEnabled(true);
+    ui->buttonRebin->setEnabled(!preview);
 
     // Setting the file path as the window title...
     setWindowTitle(mainPath);
 
     // Save the file brw path
     qDebug() << "mainPath: " << mainPath;
-
-    // Update STEP01 button
-    ui->buttonStep01->setEnabled(true);
 }
 
 
 
 void evalRegister::ButtonEvaluateClicked()
 {
+    // One batch at a time, clicks on the maps are the only work allowed meanwhile
+    if (scheduler.isBatchRunning()) {
+        return;
+    }
+
     // Checking for a file seleted
     if(ui->textFileSelected->text().isEmpty()) {
         QMessageBox::warning(this, "File not selected", "Please select a file to evaluate");
@@ -284,6 +413,13 @@ void evalRegister::ButtonEvaluateClicked()
         return;
     }
 
+    // Following sets its own window, the segments completed so far
+    if (ui->followCheckBox->isChecked() && (ui->windowStartSpinBox->value() > 0 || ui->windowEndSpinBox->value() > 0)) {
+        QMessageBox::warning(this, "Window not available", "A recording that is being followed is evaluated from its "
+                             "start as it grows. Clear the time window (0 - 0 s) or turn off Follow.");
+        return;
+    }
+
     // Returnig to the main path
     if (QDir::currentPath() != QCoreApplication::applicationDirPath()) {
         QDir::setCurrent(QCoreApplication::applicationDirPath());
@@ -293,6 +429,15 @@ void evalRegister::ButtonEvaluateClicked()
     evalJuliaString("FILEBRW", FILEBRW);
     evalJuliaFloat("MaxGB", ui->maxGBSpinBox->value());
     evalJuliaInt("minSegments", ui->spinBoxMinSegments->value());
+    evalJulia("Autotune", ui->autotuneCheckBox->isChecked() ? "true" : "false");
+    jl_eval_string("RunPeakGB = 0.0;"); // Peak of the runs of this click, see peakReport()
+
+    // A recording still being written is opened as SWMR, without the lock of its writer (only
+    // until the follow ends, FileLocking!( true ) below)
+    evalJulia("Following", ui->followCheckBox->isChecked() ? "true" : "false");
+    if (ui->followCheckBox->isChecked()) {
+        jl_eval_string("FileLocking!( false );");
+    }
 
     // Setting Graph Configuration
     evalJulia("cm_", ":" + ui->colorComboBox->currentText());
@@ -305,11 +450,49 @@ void evalRegister::ButtonEvaluateClicked()
     evalJuliaInt("n1", ui->spinBoxN1->value());
     evalJuliaInt("n_overlap1", ui->spinBoxN_overlap->value());
 
+    // Intermediate segment dumps are opt-in
+    evalJulia("SaveBIN", ui->saveBINCheckBox->isChecked() ? "true" : "false");
+    evalJulia("SpikeTimestamps", ui->spikeTimesCheckBox->isChecked() ? "true" : "false");
+    evalJulia("Connectivity", ui->connectivityCheckBox->isChecked() ? "true" : "false");
+
+    // Optional filter bank
+    evalJuliaString("FilterKind", ui->filterComboBox->currentText());
+    evalJuliaFloat("FilterLow", ui->filterLowSpinBox->value());
+    evalJuliaFloat("FilterHigh", ui->filterHighSpinBox->value());
+
+    // Optional time window and ROI, only their frames and rows are read
+    evalJuliaFloat("WindowStart", ui->windowStartSpinBox->value());
+    evalJuliaFloat("WindowEnd", ui->windowEndSpinBox->value());
+    if (ui->roiEvalCheckBox->isChecked() && !mapRoi.isEmpty()) {
+        evalJulia("RoiChannels", QString("sort( vec( [ y * 64 + x + 1 for x in %1:%2, y in %3:%4 ] ) )")
+                                     .arg(mapRoi.left()).arg(mapRoi.right()).arg(mapRoi.top()).arg(mapRoi.bottom()));
+    } else {
+        evalJulia("RoiChannels", "Int[ ]");
+    }
+
     // Julia Callings
     jl_eval_string("cd(\"methods/\");");
 
-    // Step 1 - Only the graphs
-    jl_eval_string("include(\"CODE_STEP_00.jl\");");
+    // Step 1 - Only the graphs (the autotuner times real segments, it runs like a batch so the
+    // window stays responsive and it can be cancelled)
+    if (ui->autotuneCheckBox->isChecked()) {
+        QProgressDialog tuning("Measuring segment lengths...", "Cancel", 0, 0, this);
+        tuning.setWindowFlags(tuning.windowFlags() & ~Qt::WindowContextHelpButtonHint);
+        tuning.setWindowModality(Qt::WindowModal);
+        tuning.setMinimumDuration(0);
+        tuning.setValue(0);
+        QApplication::processEvents();
+
+        beginBatch(tuning);
+        jl_eval_string("include(\"CODE_STEP_00.jl\");");
+        endBatch();
+    } else {
+        jl_eval_string("include(\"CODE_STEP_00.jl\");");
+    }
+
+    // CODE_STEP_00 set up what the spectrograms need: a click during the segments must not
+    // include CODE_SPEC.jl, it would put back the Variables, N and paths of the previous run
+    specLoaded = true;
 
     // Assign the return value of Julia to a C object of Julia type
     QString description = juliaStringValue("Variables[\"Description\"]");
@@ -317,9 +500,11 @@ void evalRegister::ButtonEvaluateClicked()
     float fs = juliaFloatValue("fs");
     float ft = juliaFloatValue("ft");
     int defaultTime = juliaIntValue("flagQtUI");
+    float memEstimate = juliaFloatValue("MemEstimate");
 
-    // Checking for Δt
-    jl_eval_string("maxLim = floor(Int, ( ft * 1000 ) - 1);");
+    // Checking for Δt (the shortest segment bounds it; GetChunkSize folds any tail shorter
+    // than twice Δt, so only segments that are all short lower it, never below 1 ms)
+    jl_eval_string("maxLim = max( floor(Int, ( ftmin * 1000 ) - 1), 1 );");
     int maxLim = juliaIntValue("maxLim");
 
     // Setting spinBoxVoltageInt maximumValue and Δt to highest value in Julia
@@ -338,7 +523,7 @@ void evalRegister::ButtonEvaluateClicked()
     ui->label_fs->setText("BINSIZE: " + QString::number(fs) + " GB");
 
     if(defaultTime == 1 ) {
-        ui->label_ft->setText("BINTIME: " + QString::number(ft) + " seg (Default Time)" );
+        ui->label_ft->setText("BINTIME: " + QString::number(ft) + " seg (Adjusted)" );
     } else {
         ui->label_ft->setText("BINTIME: " + QString::number(ft) + " seg" );
     }
@@ -346,53 +531,233 @@ void evalRegister::ButtonEvaluateClicked()
     QString continueProcess = "";
 
     if(defaultTime == 1) { // Default
-        continueProcess = "Do you want to continue the process?\n\nSegments: " + QString::number(N) + "\nBINSIZE: " + QString::number(fs) + " GB\nBINTIME: " + QString::number(ft) + " seg (Default Time)";
+        continueProcess = "Do you want to continue the process?\n\nSegments: " + QString::number(N) + "\nBINSIZE: " + QString::number(fs) + " GB\nBINTIME: " + QString::number(ft) + " seg (Adjusted)";
     } else { // No Default
         continueProcess = "Do you want to continue the process?\n\nSegments: " + QString::number(N) + "\nBINSIZE: " + QString::number(fs) + " GB\nBINTIME: " + QString::number(ft) + " seg";
     }
 
+    continueProcess += "\nMemory: ~" + QString::number(memEstimate) + " GB of " + QString::number(ui->maxGBSpinBox->value()) + " GB";
+
+    // What the autotuner measured, when it ran
+    QString tuneReport = juliaStringValue("TuneReport");
+    if (!tuneReport.isEmpty()) {
+        continueProcess += "\n\n" + tuneReport;
+    }
+
     // Sharing N, BINSIZE and Time
     QMessageBox::StandardButton accepted;
     accepted = QMessageBox::question(nullptr, "Confirm",
                                   continueProcess,
                                   QMessageBox::Yes | QMessageBox::No);
-    if (accepted == QMessageBox::No) { return; }
+    if (accepted == QMessageBox::No) {
+        specLoaded = false; // The maps shown are of the loaded project, not of this CODE_STEP_00
+        jl_eval_string("FileLocking!( true );");
+        return;
+    }
 
-    // Clearing Spectro img
+    // Clearing Spectro img, the maps shown belong to the previous run
     ui->imgLabel->clear();
+    closeAtlases();
+
+    // Results are found again by the contents of the BRW, a recording still growing has none
+    recordingId = ui->followCheckBox->isChecked() ? QString() : RecordingCache::fingerprint(FILEBRW);
+    FigureViewer::setRecording(recordingId);
+
+    if (ui->previewCheckBox->isChecked()) {
+        evaluatePreview(N);
+        jl_eval_string("FileLocking!( true );");
+        return;
+    }
+
+    if (ui->followCheckBox->isChecked()) {
+        evaluateFollow();
+        jl_eval_string("FileLocking!( true );");
+        return;
+    }
+
+    // The same recording evaluated before with these parameters: its results are put back
+    // (not with segment dumps, the spectrograms would read them)
+    QString project = juliaStringValue("PATHMAIN");
+    QString runKey = ui->saveBINCheckBox->isChecked() ? QString() : ArtifactCache::key(recordingId, "STEP00", 0, 0, juliaStringValue("RunParameters( )"));
+    bool canceled = false;
+    traceViewer->clear(); // Unmaps the pyramid, the run or the restore replaces it
+
+    // Nothing of an earlier run may outlive the restore, e.g. the figures of more segments
+    QStringList previous = { "Figures/STEP00" };
+    for (const QString &name : step00InfoFiles) {
+        previous.append("Info/" + name);
+    }
+
+    if (ArtifactCache::restore(runKey, project, previous)) {
+        jl_eval_string("CloseRaw( RAW ); RAW = nothing;");
+        qDebug() << "STEP00 restored from the artifact cache";
+    } else {
+        canceled = runStep00(N);
+        if (!canceled) {
+            ArtifactCache::insert(runKey, project, step00Artifacts(project));
+        }
+    }
+
+    finishStep00(canceled);
+
+    // Combined mode: STEP01 streams every segment again from the BRW, right after STEP00
+    if (ui->fuseStep01CheckBox->isChecked() && !canceled && searchInfoBRW() != nullptr) {
+        STEP01();
+        QDir::setCurrent(mainPath);
+        saveToIni();
+    }
+
+    // Step-01-Finished Message...
+    QMessageBox::about(this, "Finished process", "The process has finished...\n\n" + peakReport());
+}
+
+
+
+// Every segment through STEP00, then its results saved; true when it was cancelled
+bool evalRegister::runStep00(int N)
+{
+    jl_eval_string("RunBaselineGB = CurrentRSS( ) / ( 1024 ^ 3 );"); // Before the arena, it is part of the segments
+
+    // The trace pyramid is rewritten while the segments are read, unless only part of the
+    // recording is (the one of a previous full run is kept)
+    jl_eval_string("Pyramid = Restricted ? nothing : OpenPyramid( FILEPYRAMID, Variables );");
 
-    // For loop Step-00...
+    // Mergeable statistics of every quarter segment, for Re-bin (the codes only without a filter)
+    jl_eval_string("Sketch = haskey( Variables, \"Channels\" ) ? nothing : OpenSketch( FILESKETCH, Variables, Δt; split = SketchSplit, codes = isnothing( Filter ) );");
+
+    // Segment buffers are reused by every iteration (and every run)
+    arena.bind("ARENA_RAW", qint64(juliaIntValue("nChs")) * juliaIntValue("ArenaFrames"));
+    trendView->reset(juliaIntValue("nChs"), N);
+    behaviorChart->reset(N);
+    behaviorChart->show(); // Live while the segments finish
+
+    // For loop Step-00... (non-modal, the maps stay clickable while it runs)
     QProgressDialog progress("Getting segments...", "Cancel", 0, N + 1, this);
     progress.setWindowFlags(progress.windowFlags() & ~Qt::WindowContextHelpButtonHint);
-    progress.setWindowModality(Qt::WindowModal);
+    progress.setWindowModality(Qt::NonModal);
     progress.setMinimumDuration(0);
     progress.setValue(0);
 
     // Update ui to show everyEvent (Force to show QProgressBar)
     QApplication::processEvents();
 
+    beginBatch(progress);
     for(int n = 1; n <= N; n++) {
-        if (progress.wasCanceled()) { break; }
-        evalJuliaInt("n", n);
-        STEP00();
-        progress.setValue(n);
-        if (progress.wasCanceled()) { break; }
-        QApplication::processEvents();
+        scheduler.submit(JobScheduler::Batch, "STEP00", [this, n, &progress]() {
+            evalJuliaInt("n", n);
+            memoryTrackStart();
+            STEP00();
+
+            // A segment cut short keeps none of its results
+            if (scheduler.isCanceled()) {
+                jl_eval_string("foreach( R -> R[ n ] = [ ], ( Cardinality, VoltageShiftDeviation, Empties, BandAbs, BandRel, FiringRate, SpikeNoise, SpikeTimes, LocalCorr, GlobalCorr ) );");
+                return;
+            }
+
+            updateTrend(n, true);
+            progress.setLabelText("Getting segments...\n" + memoryTrackStop());
+            progress.setValue(n);
+        });
+    }
+    bool canceled = !scheduler.run();
+    endBatch();
+    progress.setValue(N + 1);
+
+    codeStep00_saving();
+    return canceled;
+}
+
+
+
+// What a STEP00 run leaves in the project, kept by the artifact cache
+QStringList evalRegister::step00Artifacts(const QString &project)
+{
+    QStringList files;
+    for (const QString &name : step00InfoFiles) {
+        if (QFileInfo::exists(project + "/Info/" + name)) {
+            files.append("Info/" + name);
+        }
+    }
+    files += ArtifactCache::files(project, "Figures/STEP00");
+    return files;
+}
+
+
+
+// Every segment through STEP01, then its results saved; true when it was cancelled
+bool evalRegister::runStep01()
+{
+    jl_eval_string("RunBaselineGB = CurrentRSS( ) / ( 1024 ^ 3 );"); // Before the arena, it is part of the segments
+
+    // Segment buffers are reused by every iteration (and every run)
+    qint64 arenaElements = qint64(juliaIntValue("Variables[ \"nChs\" ]")) * juliaIntValue("ArenaFrames");
+    arena.bind("ARENA_RAW", arenaElements);
+    arena.bind("ARENA_PATCH", arenaElements);
+
+    // Assign the return value of Julia to a C object of Julia type
+    int N = juliaIntValue("N");
+    trendView->reset(juliaIntValue("Variables[ \"nChs\" ]"), N);
+
+    // For loop Step-01... (non-modal, the maps stay clickable while it runs)
+    QProgressDialog progress("Getting figures...", "Cancel", 0, N + 1, this);
+    progress.setWindowFlags(progress.windowFlags() & ~Qt::WindowContextHelpButtonHint);
+    progress.setWindowModality(Qt::NonModal);
+    progress.setMinimumDuration(0);
+    progress.setValue(0);
+
+    // Update ui to show everyEvent (Force to show QProgressBar)
+    QApplication::processEvents();
+
+    beginBatch(progress);
+    for(int n = 1; n <= N; n++) {
+        scheduler.submit(JobScheduler::Batch, "STEP01", [this, n, &progress]() {
+            evalJuliaInt("n", n);
+            memoryTrackStart();
+            jl_eval_string("include(\"CODE_STEP01_Figures.jl\");"); // Stops at the first CheckCancel( ) after Cancel
+
+            // A segment cut short keeps none of its results
+            if (scheduler.isCanceled()) {
+                jl_eval_string("foreach( R -> R[ n ] = [ ], ( Sats, Repaired, Cardinality, VoltageShiftDeviation ) );");
+                return;
+            }
+
+            updateTrend(n, false);
+            progress.setLabelText("Getting figures...\n" + memoryTrackStop());
+            progress.setValue(n);
+        });
     }
+    bool canceled = !scheduler.run();
+    endBatch();
     progress.setValue(N + 1);
 
-    // Run a needed filebrw path functions....
-    /*
-     * TO DO:
-     *      This is the best place to execute the STEP01, after codeStep00_saving
-     */
+    // Calling some aditional functions
+    codeStep01_saving();
+    return canceled;
+}
+
+
+
+// Saving and showing the results of a STEP00 batch, finished or cancelled
+void evalRegister::finishStep00(bool canceled)
+{
+    // CODE_STEP_00 already set up what the spectrograms need
+    specLoaded = true;
 
     // Saving some paths from STEP00
     QFileInfo fileInfo(juliaStringValue("PATHMAIN"));
     mainPath = fileInfo.absoluteFilePath(); // Change to mainPath to saveTiIni();
+    if (!canceled) {
+        RecordingCache::remember(recordingId, mainPath);
+    }
 
     // Calling some aditional functions
-    codeStep00_saving();
+    rebuildAtlas("STEP00");
+    for (const QString &map : { "DELTA", "THETA", "ALPHA", "SPIKES" }) {
+        rebuildAtlas(map);
+    }
+    if (juliaIntValue("Int( Connectivity )")) {
+        rebuildAtlas("CONNECTIVITY");
+    }
     figuresPath("STEP00");
     ui->typeOfGraphComboBox->setEnabled(true);
 
@@ -404,75 +769,244 @@ void evalRegister::ButtonEvaluateClicked()
     ui->buttonStep01->setEnabled(true);
     ui->buttonExplorer->setEnabled(true);
     ui->buttonBinBehaviour->setEnabled(true);
+    ui->buttonRebin->setEnabled(true);
+}
 
-    // Step-01-Finished Message...
-    QMessageBox::about(this, "Finished process", "The process has finished...");
+
+
+// Follow mode: a recording that is still being written is evaluated as its segments are
+// completed. The segments have a fixed length (FollowFrames), the result arrays, the trend and
+// the Raw Bin Behavior grow with them and the maps of the newest segment are shown as soon as
+// they are drawn. Stop ends it, as does a recording that stopped growing; what was evaluated is
+// saved as any other run. There is no trace pyramid, its size needs the final length
+void evalRegister::evaluateFollow()
+{
+    jl_eval_string("RunBaselineGB = CurrentRSS( ) / ( 1024 ^ 3 );");
+    jl_eval_string("Pyramid = nothing; n0s = 4; N = 0;");
+    jl_eval_string("SegmentSlots!( 0, Cardinality, VoltageShiftDeviation, Empties, MemoryLog, BandAbs, BandRel, FiringRate, SpikeNoise, SpikeTimes, LocalCorr, GlobalCorr );");
+    jl_eval_string("FollowNfrs = FollowFrames( Variables, FollowSeconds, MaxGB );");
+    jl_eval_string("Sketch = haskey( Variables, \"Channels\" ) ? nothing : OpenSketch( FILESKETCH, Variables, Δt; split = SketchSplit, codes = isnothing( Filter ) );");
+
+    arena.bind("ARENA_RAW", qint64(juliaIntValue("nChs")) * juliaIntValue("FollowNfrs"));
+    trendView->reset(juliaIntValue("nChs"), 0);
+    behaviorChart->reset(0);
+    behaviorChart->show();
+
+    QProgressDialog progress("Following the recording...", "Stop", 0, 0, this);
+    progress.setWindowFlags(progress.windowFlags() & ~Qt::WindowContextHelpButtonHint);
+    progress.setWindowModality(Qt::NonModal);
+    progress.setMinimumDuration(0);
+
+    // A timer checks the length of the recording; meanwhile the event loop runs, and with it
+    // the clicks on the maps. The segments it finds are run as a batch
+    beginBatch(progress);
+    QEventLoop waiting;
+    QTimer growth;
+    growth.setSingleShot(true);
+    QElapsedTimer idle;
+    idle.start();
+    connect(&scheduler, &JobScheduler::cancelRequested, &waiting, &QEventLoop::quit);
+    connect(&growth, &QTimer::timeout, &waiting, [this, &progress, &idle, &growth, &waiting]() {
+        if (followNext(progress, idle)) {
+            growth.start(followInterval);
+        } else {
+            waiting.quit();
+        }
+    });
+    growth.start(0);
+    waiting.exec();
+    growth.stop();
+    endBatch();
+    progress.close();
+
+    // Stopping is how a follow ends, the segments done are kept (but not remembered for a
+    // recording that may still grow)
+    codeStep00_saving();
+    finishStep00(true);
+}
+
+
+
+// One check for newly completed segments, which are run right away; false when the follow
+// is over (stopped, or no growth for followIdle)
+bool evalRegister::followNext(QProgressDialog &progress, QElapsedTimer &idle)
+{
+    if (scheduler.isCanceled()) {
+        return false;
+    }
+
+    int N = juliaIntValue("N");
+    int available = juliaIntValue("Follow!( Variables, FollowNfrs, RAW )");
+
+    if (available <= N) {
+        if (idle.elapsed() >= followIdle) {
+            qDebug() << "The recording stopped growing, follow finished";
+            return false;
+        }
+        return true;
+    }
+
+    evalJuliaInt("N", available);
+    jl_eval_string("SegmentSlots!( N, Cardinality, VoltageShiftDeviation, Empties, MemoryLog, BandAbs, BandRel, FiringRate, SpikeNoise, SpikeTimes, LocalCorr, GlobalCorr );");
+    trendView->setSegments(available);
+    behaviorChart->setSegments(available);
+    ui->label_N->setText("SEGMENTS: " + QString::number(available));
+
+    for (int n = N + 1; n <= available; n++) {
+        scheduler.submit(JobScheduler::Batch, "STEP00", [this, n, &progress]() {
+            evalJuliaInt("n", n);
+            memoryTrackStart();
+            STEP00();
+
+            if (scheduler.isCanceled()) {
+                jl_eval_string("foreach( R -> R[ n ] = [ ], ( Cardinality, VoltageShiftDeviation, Empties, BandAbs, BandRel, FiringRate, SpikeNoise, SpikeTimes, LocalCorr, GlobalCorr ) );");
+                return;
+            }
+
+            // The newest maps, straight from their figures
+            QString figure = juliaStringValue("joinpath( PATHFIGURES_STEP00, string( \"BIN\", lpad( n, n0s, \"0\" ) ) )");
+            figureViewer->setImage(figure + "_.png");
+            figureViewer_STD->setImage(figure + "_std.png");
+
+            updateTrend(n, true);
+            progress.setLabelText(QString("Following the recording: segment %1\n").arg(n) + memoryTrackStop());
+        });
+    }
+
+    idle.restart();
+    return scheduler.run();
 }
 
 
 
+// Native chart from the sums gathered during STEP00 (or read from STEP00.res), no Julia
 void evalRegister::ButtonBinBehavior()
 {
-    // Checking if PATHINFO is ok!
-    if(searchInfoBRW() == nullptr) {
+    if (behaviorChart->isEmpty()) {
+        QMessageBox::warning(this, "No results", "Evaluate or load a recording to see the Raw Bin Behavior.");
         return;
     }
 
-    evalJuliaString("PATHINFO", searchInfoBRW());
-    evalJuliaString("mainPath", mainPath);
+    behaviorChart->show();
+    behaviorChart->raise();
 
-    jl_eval_string("println(PATHINFO);");
+    // The figure is still written where the Julia script left it (mainPath is the new one only after a run)
+    QString generalPath = mainPath + "/Figures/GENERAL";
+    if (!scheduler.isBatchRunning() && !mainPath.isEmpty() && QDir().mkpath(generalPath)) {
+        behaviorChart->grab().save(generalPath + "/RawBinBehavior.png");
+    }
+}
 
-    // Change path to execute CODE_BinBehavior.jl
-    evalJuliaString("appPath", QCoreApplication::applicationDirPath());
-    jl_eval_string("cd(appPath)");
 
-    // Julia Callings
-    jl_eval_string("cd(\"methods/\");");
-    jl_eval_string("include(\"CODE_BinBehavior.jl\");");
 
-    // Returning to the mainPath
-    jl_eval_string("cd(mainPath)");
+// STEP00 maps with segments of several base blocks, merged from Info/Sketch.bin (no BRW read)
+void evalRegister::ButtonRebinClicked()
+{
+    if (scheduler.isBatchRunning()) {
+        return;
+    }
+
+    QString sketchPath = mainPath + "/Info/Sketch.bin";
+    if (mainPath.isEmpty() || !QFileInfo::exists(sketchPath)) {
+        QMessageBox::warning(this, "No sketch", "Evaluate the recording (without a channel ROI) to re-bin its segments.");
+        return;
+    }
 
-    // Setting BinBehaviour in imgLabel
-    QString figure = QDir::cleanPath(juliaStringValue("FILEFIGURE_RawBinBehavior")) + ".png";
-    qDebug() << "Figure:" << figure;
-    ui->imgLabel->setPixmap(QPixmap(figure));
+    prepareSpec();
+    jl_eval_string("SketchBlocks, SketchSeconds, SketchPerSegment, _ = SketchInfo( joinpath( PATHINFO, \"Sketch.bin\" ) );");
+    int blocks = juliaIntValue("SketchBlocks");
+    if (blocks <= 0) {
+        qDebug() << "Error: Empty sketch" << sketchPath;
+        return;
+    }
+
+    bool ok = false;
+    QString label = QString("Base blocks of %1 s (%2 per segment of the run) in each new segment:")
+                        .arg(juliaFloatValue("SketchSeconds"), 0, 'g', 3).arg(juliaIntValue("SketchPerSegment"));
+    int m = QInputDialog::getInt(this, "Re-bin STEP00", label, juliaIntValue("SketchPerSegment"), 1, blocks, 1, &ok);
+    if (!ok) {
+        return;
+    }
+
+    evalJuliaInt("m", m);
+    evalJulia("cm_", ":" + ui->colorComboBox->currentText());
+    int segments = juliaIntValue("RebinResults( PATHINFO, m; colormap = cm_ )");
+    qDebug() << "Re-binned segments: " << segments;
+
+    closeAtlases();
+    const QSignalBlocker blocker(ui->typeOfGraphComboBox);
+    ui->typeOfGraphComboBox->setCurrentText("REBIN");
+    figuresPath("REBIN");
 }
 
 
 
 void evalRegister::ComboBoxCurrentTextChanged(const QString &arg1)
 {
-//  Template for a QPixmap: ui->imgLabel->setPixmap(pic.scaled(ui->imgLabel->size(), Qt::KeepAspectRatioByExpanding, Qt::SmoothTransformation)); // Qt::KeepAspectRatio,Qt::SmoothTransformation));
-    QString parentDirPath;
-    int typeOfGraph = ui->typeOfGraphComboBox->currentIndex();
+    int currentIndex = ui->myComboBox->currentIndex();
 
-    switch (typeOfGraph) {
-        case 0:
-            parentDirPath = QFileInfo(mainPath).absoluteFilePath() + "/Figures/STEP00";
-            break;
-        case 1:
-            parentDirPath = QFileInfo(mainPath).absoluteFilePath() + "/Figures/STEP01";
-            break;
+    if (atlas == nullptr || currentIndex < 0 || currentIndex >= atlas->count()) {
+        if (!arg1.isEmpty()) {
+            qDebug() << "Error: No map found for" << arg1;
+        }
+        return;
     }
 
-    QString fileSVG = parentDirPath + "/" + arg1 + ".png";
-    QString fileSVG2 = parentDirPath + "/" + arg1 + "std.png";
+    // Both maps are views into the memory-mapped atlas
+    figureViewer->setImage(atlas->map(currentIndex, MapAtlas::Cardinality));
+    figureViewer_STD->setImage(atlas->map(currentIndex, MapAtlas::VoltageShiftDeviation));
+    figureViewer->BINSelected_Func(currentIndex);
+    figureViewer_STD->BINSelected_Func(currentIndex);
 
-    // Research/Update for files added or removed
-    if(QPixmap().load(fileSVG) && QPixmap().load(fileSVG2)) {
-        figureViewer->setImage(fileSVG);
-        figureViewer_STD->setImage(fileSVG2);
-        int currentIndex = ui->myComboBox->currentIndex();
-        figureViewer->BINSelected_Func(currentIndex);
-    } else {
-        qDebug() << "Error: No file found";
-        int index = ui->myComboBox->findText(arg1);
-        if (index != -1) {
-            ui->myComboBox->removeItem(index);
-        }
+    // Keeping the slider on the same segment
+    const QSignalBlocker blocker(ui->segmentSlider);
+    ui->segmentSlider->setValue(currentIndex);
+}
+
+
+
+void evalRegister::SegmentSliderValueChanged(int value)
+{
+    ui->myComboBox->setCurrentIndex(value);
+}
+
+
+
+void evalRegister::ButtonPlayClicked()
+{
+    if (playTimer->isActive()) {
+        playTimer->stop();
+        ui->buttonPlay->setText("Play");
+        return;
+    }
+
+    if (ui->myComboBox->count() == 0) {
+        return;
+    }
+
+    // Starting over when the last segment is shown
+    if (ui->myComboBox->currentIndex() == ui->myComboBox->count() - 1) {
+        ui->myComboBox->setCurrentIndex(0);
+    }
+
+    // One segment per display refresh
+    qreal refreshRate = (screen() != nullptr) ? screen()->refreshRate() : 60.0;
+    playTimer->start(qMax(1, qRound(1000.0 / refreshRate)));
+    ui->buttonPlay->setText("Stop");
+}
+
+
+
+void evalRegister::PlayTimerTimeout()
+{
+    int next = ui->myComboBox->currentIndex() + 1;
+
+    if (next >= ui->myComboBox->count()) {
+        ButtonPlayClicked(); // Stop at the last segment
+        return;
     }
+
+    ui->myComboBox->setCurrentIndex(next);
 }
 
 
@@ -484,6 +1018,24 @@ void evalRegister::typeOfGraphComboBoxTextChanged(const QString &arg1)
 
 
 
+// The two cut-offs mean centre and width for the notch
+void evalRegister::filterComboBoxTextChanged(const QString &arg1)
+{
+    bool enabled = (arg1 != "None");
+    ui->filterLowSpinBox->setEnabled(enabled);
+    ui->filterHighSpinBox->setEnabled(enabled);
+
+    if (arg1 == "Bandpass") {
+        ui->filterLowSpinBox->setValue(1.0);
+        ui->filterHighSpinBox->setValue(3000.0);
+    } else if (arg1 == "Notch") {
+        ui->filterLowSpinBox->setValue(60.0);
+        ui->filterHighSpinBox->setValue(2.0);
+    }
+}
+
+
+
 void evalRegister::colorComboBoxTextChanged(const QString &arg1)
 {
     QString filePath = QString(QCoreApplication::applicationDirPath() + "/resources/cbar/%1.png").arg(arg1);
@@ -492,6 +1044,7 @@ void evalRegister::colorComboBoxTextChanged(const QString &arg1)
     // Check if the image was uploaded
     if (!pixmap.isNull()) {
         ui->labelCbar->setPixmap(pixmap);
+        trendView->setColorbar(pixmap.toImage());
     } else {
         ui->labelCbar->setText("Error: Cbar not found.");
         ui->labelCbar->clear();
@@ -507,45 +1060,124 @@ void evalRegister::figuresPath(const QString &figures)
 
     QFileInfo fileInfo(directoryPath);
     QDir parentDir = fileInfo.absoluteDir().absolutePath() + "/..";
-    QString figuresPath = parentDir.absolutePath() + "/" + fileInfo.baseName() + "/Figures/" + figures;
+    QString projectPath = parentDir.absolutePath() + "/" + fileInfo.baseName();
 
-    qDebug() << "Figures Path: " << figuresPath;
-    qDebug() << "Parent Dir: " << parentDir;
+    qDebug() << "Project Path: " << projectPath;
 
-    QDir figuresDir(figuresPath);
+    // The maps of each step live in one atlas, opened once and kept mapped
+    MapAtlas *stepAtlas = &atlases[figures];
+    if (!stepAtlas->isOpen()) {
+        stepAtlas->openStep(projectPath, figures);
+    }
 
-    if (!figuresDir.exists()) {
+    if (!stepAtlas->isOpen()) {
         QMessageBox::warning(this, "Folder not found", "The 'Figures' folder was not found in the specified directory.");
         return;
     }
 
-    QStringList nameFilters;
-    nameFilters << "*_.png";
-
-    QFileInfoList filesInfo = figuresDir.entryInfoList(nameFilters, QDir::Files, QDir::Name);
-
-    QStringList files;
-    for (const QFileInfo &fileInfo : filesInfo) {
-        QString fileNameNoExtension = fileInfo.completeBaseName();
-        files.append(fileNameNoExtension);
+    // The trend of the step from its results, unless a run is filling it
+    ResultsStore trendStore;
+    qint64 previewCount = 0;
+    bool approximate = false;
+    if (!scheduler.isBatchRunning() && trendStore.open(projectPath + "/Info/" + figures + ".res")
+        && trendStore.column("Cardinality", 0) != nullptr) {
+        trendView->load(trendStore);
+        if (figures == "STEP00") {
+            behaviorChart->load(trendStore);
+        }
+        approximate = trendStore.list("Preview", previewCount) != nullptr;
     }
+    figureViewer->setApproximate(approximate);
+    figureViewer_STD->setApproximate(approximate);
 
-    qDebug() << "Files: " << files;
+    atlas = stepAtlas;
+    QStringList files = atlas->names();
 
+    qDebug() << "Segments: " << files.size();
+
+    ui->segmentSlider->setRange(0, qMax(0, files.size() - 1));
     ui->myComboBox->clear();
     ui->myComboBox->addItems(files);
     ui->myComboBox->setCurrentIndex(0);
+
+    // closeAtlases left the comparison blank
+    if (compareWindow != nullptr) {
+        compareWindow->refresh();
+    }
 }
 
 
 
-void evalRegister::ButtonStep01Clicked() // This function need to be Update
+// Rewrites the atlas of a step after its figures changed
+void evalRegister::rebuildAtlas(const QString &figures)
 {
+    closeAtlases();
+
+    QFileInfo fileInfo(FILEBRW);
+    QDir parentDir = fileInfo.absoluteDir().absolutePath() + "/..";
+    QString projectPath = parentDir.absolutePath() + "/" + fileInfo.baseName();
+
+    if (!MapAtlas::buildStep(projectPath, figures)) {
+        qDebug() << "Error: Atlas not built for" << projectPath + "/Figures/" + figures;
+        QMessageBox::warning(this, "Maps not updated", "The " + figures + " maps could not be written. Close any other "
+                             "program using the project folder and evaluate again; the maps shown may be from an earlier run.");
+    }
+}
+
+
+
+// The viewers may show mapped memory, so they are cleared before unmapping
+void evalRegister::closeAtlases()
+{
+    if (playTimer->isActive()) {
+        ButtonPlayClicked();
+    }
+
+    figureViewer->clear();
+    figureViewer_STD->clear();
+    FigureViewer::clearSpectrogramCache();
+
+    atlas = nullptr;
+    for (auto &stepAtlas : atlases) {
+        stepAtlas.second.close();
+    }
+
+    // The comparison may have the same atlases mapped
+    if (compareWindow != nullptr) {
+        compareWindow->closeAtlases();
+    }
+}
+
+
+
+void evalRegister::ButtonStep01Clicked()
+{
+    // One batch at a time, clicks on the maps are the only work allowed meanwhile
+    if (scheduler.isBatchRunning()) {
+        return;
+    }
+
     // Checking if PATHINFO is ok!
     if(searchInfoBRW() == nullptr) {
         return;
     }
 
+    jl_eval_string("RunPeakGB = 0.0;");
+    STEP01();
+
+    // Setting mainPath to saveToIni()
+    QDir::setCurrent(mainPath);
+    saveToIni();
+
+    // Step-01-Finished Message...
+    QMessageBox::about(this, "Finished process", "The process has finished...\n\n" + peakReport());
+}
+
+
+
+// Repairs and evaluates every segment, from the STEP00 dumps or streamed from the BRW
+void evalRegister::STEP01()
+{
     evalJuliaString("PATHINFO", searchInfoBRW());
     evalJuliaString("mainPath", mainPath);
     jl_eval_string("println(\"PATHMAIN: \", mainPath)");
@@ -556,84 +1188,93 @@ void evalRegister::ButtonStep01Clicked() // This function need to be Update
     evalJuliaFloat("limSat", ui->doubleSpinBoxLimSat->value());
     evalJuliaInt("THR_EMP", ui->spinBoxVoltageThr->value());
     evalJuliaInt("Δt", ui->spinBoxVoltageInt->value());
+    evalJulia("SaveBIN", ui->saveBINCheckBox->isChecked() ? "true" : "false");
 
     // Change path to execute STEP01.jl
     evalJuliaString("appPath", QCoreApplication::applicationDirPath());
     jl_eval_string("cd(appPath)");
 
+    // Clicks during the batch must not include CODE_SPEC.jl halfway through a segment
+    if (!specLoaded) {
+        loadSpec();
+        jl_eval_string("cd(appPath)");
+    }
+
     // Julia Callings
     jl_eval_string("cd(\"methods/\");");
     jl_eval_string("include(\"CODE_STEP_01.jl\");");
 
-    // Assign the return value of Julia to a C object of Julia type
-    int N = juliaIntValue("N");
-
-    // For loop Step-01...
-    QProgressDialog progress("Getting figures...", "Cancel", 0, N + 1, this);
-    progress.setWindowFlags(progress.windowFlags() & ~Qt::WindowContextHelpButtonHint);
-    progress.setWindowModality(Qt::WindowModal);
-    progress.setMinimumDuration(0);
-    progress.setValue(0);
+    // The same STEP00 run and STEP01 settings as before: the results and figures are put back
+    QString project = juliaStringValue("PATHMAIN");
+    QString runKey = ArtifactCache::key(recordingId, "STEP01", 0, 0, juliaStringValue("Step01Parameters( )"));
 
-    // Update ui to show everyEvent (Force to show QProgressBar)
-    QApplication::processEvents();
-
-    for(int n = 1; n <= N; n++) {
-        if (progress.wasCanceled()) { break; }
-        evalJuliaInt("n", n);
-        jl_eval_string("include(\"CODE_STEP01_Figures.jl\");");
-        progress.setValue(n);
-        if (progress.wasCanceled()) { break; }
-        QApplication::processEvents();
+    if (ArtifactCache::restore(runKey, project, { "Figures/STEP01", "Info/STEP01.res" })) {
+        jl_eval_string("Parameters = nothing; step00 = nothing;");
+        qDebug() << "STEP01 restored from the artifact cache";
+    } else {
+        bool canceled = runStep01();
+
+        // The figures of every segment, drawn from STEP01.res on all cores
+        closeAtlases();
+        FigureExport::writeStep(juliaStringValue("FILESTEP01"), juliaStringValue("PATHFIGURES_STEP01"), !ui->deferFiguresCheckBox->isChecked());
+        if (!canceled) {
+            QStringList files = { "Info/STEP01.res", "Info/Parameters.jld2", "Info/Memory.jld2" };
+            ArtifactCache::insert(runKey, project, files + ArtifactCache::files(project, "Figures/STEP01"));
+        }
     }
-    progress.setValue(N + 1);
-
-    // Calling some aditional functions
-    codeStep01_saving();
+    rebuildAtlas("STEP01");
     figuresPath("STEP01");
     ui->typeOfGraphComboBox->setEnabled(true);
-
-    // Setting mainPath to saveToIni()
-    QDir::setCurrent(mainPath);
-    saveToIni();
-
-    // Step-01-Finished Message...
-    QMessageBox::about(this, "Finished process", "The process has finished...");
 }
 
 
 
 void evalRegister::STEP00()
 {
-    jl_eval_string("BINRAW = OneSegment( RAW, Variables, n, N );");
-    jl_eval_string("BINRAW = Digital2Analogue( Variables, BINRAW );");
-    jl_eval_string("local nChs, nfrs = size( BINRAW );");
+    jl_eval_string("BINDIG = OneSegment( RAW, Variables, n, N );");
+    jl_eval_string("isnothing( Pyramid ) || AddPyramid!( Pyramid, BINDIG );");
 
-    if (ui->saveBINCheckBox->checkState() == 2 ) {
-        jl_eval_string("BINNAME = joinpath( PATHSTEP00, string( \"BIN\", lpad( n, n0s, \"0\" ), \".jld2\" ) );");
-        jl_eval_string("jldsave( BINNAME; Data = Float16.( BINRAW ) );");
-    }
+    // # Spikes, on the ADC codes (with a ROI the kernels see its rows, the results are put back
+    // among all the channels)
+    jl_eval_string("fr0, frN = SegmentFrames( Variables, n, N );");
+    jl_eval_string("FiringRate[ n ], SpikeNoise[ n ], SpikeTimes[ n ] = map( R -> ExpandChannels( R, Variables ), SpikeDetect( Variables, BINDIG; timestamps = SpikeTimestamps, fr0 = fr0 ) );");
+    if (scheduler.poll()) { return; } // Cancelled, the kernels already stopped
+
+    jl_eval_string("BINRAW = Digital2Analogue!( ArenaMatrix( ARENA_RAW, size( BINDIG )... ), Variables, BINDIG );");
+    jl_eval_string("nChs, nfrs = size( BINRAW );");
+
+    // The run's own setting, the checkbox may have changed since it started
+    jl_eval_string("if SaveBIN; BINNAME = joinpath( PATHSTEP00, string( \"BIN\", lpad( n, n0s, \"0\" ), \".jld2\" ) ); jldsave( BINNAME; Data = Float16.( BINRAW ) ); end");
 
     jl_eval_string("SatChs, SatFrs = SupInfThr( BINRAW, THR_EMP );");
     jl_eval_string("PerSat = zeros( nChs );");
     jl_eval_string("PerSat[ SatChs ] .= round.( length.( SatFrs ) ./ nfrs, digits = 2 );");
-    jl_eval_string("empties = findall( PerSat .>= limSat );");
+    jl_eval_string("empties = get( Variables, \"Channels\", 1:nChs )[ findall( PerSat .>= limSat ) ];");
+    if (scheduler.poll()) { return; }
+
+    // # Band power (every channel at once)
+    jl_eval_string("BandAbs[ n ], BandRel[ n ] = map( R -> ExpandChannels( R, Variables ), BandPower( Variables, BINRAW ) );");
+
+    // # Optional filter, saturations and band power stay on the raw signal
+    jl_eval_string("isnothing( Filter ) || FilterSegment!( Filter, BINRAW );");
+    if (scheduler.poll()) { return; }
 
     // # Cardinality
-    jl_eval_string("Cardinality[ n ] = UniqueCount( BINRAW );"); // sigma
-    jl_eval_string("data = zscore( PatchEmpties( Cardinality[ n ], empties ) );");
-    jl_eval_string("P = Zplot( data, cm_ );");
-    jl_eval_string("PF = plot( P, wsize = ( 64, 64 ), cbar = false, margins = -2mm );");
-    jl_eval_string("FIGNAME = joinpath( PATHFIGURES_STEP00, string( \"BIN\", lpad( n, n0s, \"0\" ), \"_\" ) );");
-    jl_eval_string("Plots.png( PF, FIGNAME );");
+    jl_eval_string("Cardinality[ n ] = ExpandChannels( UniqueCount( BINRAW ), Variables );"); // sigma
+    step00Figure("Cardinality", "_");
+    if (scheduler.poll()) { return; }
 
     // # VoltageShiftDeviation
-    jl_eval_string("VoltageShiftDeviation[ n ] = STDΔV( Variables, BINRAW, Δt );");
-    jl_eval_string("data = zscore( PatchEmpties( VoltageShiftDeviation[ n ], empties ) );");
-    jl_eval_string("P = Zplot( data, cm_ );");
-    jl_eval_string("PF = plot( P, wsize = ( 64, 64 ), cbar = false, margins = -2mm );");
-    jl_eval_string("FIGNAME = joinpath( PATHFIGURES_STEP00, string( \"BIN\", lpad( n, n0s, \"0\" ), \"_std\" ) );");
-    jl_eval_string("Plots.png( PF, FIGNAME );");
+    jl_eval_string("VoltageShiftDeviation[ n ] = ExpandChannels( STDΔV( Variables, BINRAW, Δt ), Variables );");
+    step00Figure("VoltageShiftDeviation", "_std");
+    if (scheduler.poll()) { return; }
+
+    // # Optional connectivity, on the filtered signal
+    jl_eval_string("if Connectivity; LocalCorr[ n ], GlobalCorr[ n ] = map( R -> ExpandChannels( R, Variables ), ChannelCorrelation( Variables, BINRAW ) ); end");
+    if (scheduler.poll()) { return; }
+
+    // # Sketch, after the last poll so a cancelled segment leaves no blocks behind
+    jl_eval_string("isnothing( Sketch ) || AddSketch!( Sketch, BINDIG, BINRAW, fr0 );");
 
     // Last part of for loop
     jl_eval_string("Empties[ n ] = empties;");
@@ -642,6 +1283,112 @@ void evalRegister::STEP00()
 
 
 
+// Quick look at segment n: the STEP00 maps from the runs of PreviewSegment, no filter (the
+// runs are not contiguous), spikes, bands or connectivity
+void evalRegister::STEP00Preview()
+{
+    jl_eval_string("BINDIG, PreviewFrames = PreviewSegment( RAW, Variables, n, N, Δt; windows = PreviewWindows );");
+    jl_eval_string("BINRAW = Digital2Analogue!( ArenaMatrix( ARENA_RAW, size( BINDIG )... ), Variables, BINDIG );");
+    jl_eval_string("nChs, nfrs = size( BINRAW );");
+
+    jl_eval_string("SatChs, SatFrs = SupInfThr( BINRAW, THR_EMP );");
+    jl_eval_string("PerSat = zeros( nChs );");
+    jl_eval_string("PerSat[ SatChs ] .= round.( length.( SatFrs ) ./ nfrs, digits = 2 );");
+    jl_eval_string("empties = get( Variables, \"Channels\", 1:nChs )[ findall( PerSat .>= limSat ) ];");
+    if (scheduler.poll()) { return; }
+
+    jl_eval_string("Cardinality[ n ] = ExpandChannels( UniqueCount( BINRAW ), Variables );");
+    step00Figure("Cardinality", "_");
+    jl_eval_string("VoltageShiftDeviation[ n ] = ExpandChannels( STDΔV( Variables, BINRAW, Δt; window = PreviewFrames ), Variables );");
+    step00Figure("VoltageShiftDeviation", "_std");
+
+    jl_eval_string("Empties[ n ] = empties;");
+}
+
+
+
+// Map of one STEP00 metric of segment n, Figures/STEP00/BINnn<suffix>.png
+void evalRegister::step00Figure(const QString &metric, const QString &suffix)
+{
+    evalJulia("data", "ZscoreFinite( PatchEmpties( " + metric + "[ n ], empties ) )");
+    jl_eval_string("P = Zplot( data, cm_ );");
+    jl_eval_string("PF = plot( P, wsize = ( 64, 64 ), cbar = false, margins = -2mm );");
+    evalJulia("FIGNAME", "joinpath( PATHFIGURES_STEP00, string( \"BIN\", lpad( n, n0s, \"0\" ), \"" + suffix + "\" ) )");
+    jl_eval_string("Plots.png( PF, FIGNAME );");
+}
+
+
+
+// Approximate STEP00 of every segment, written where the full run writes its maps (so the
+// next full Evaluate replaces them) with a "Preview" list in STEP00.res that marks them. The
+// trace pyramid, the sketch and the other steps are left as they were
+void evalRegister::evaluatePreview(int N)
+{
+    arena.bind("ARENA_RAW", qint64(juliaIntValue("nChs")) * juliaIntValue("ArenaFrames"));
+    trendView->reset(juliaIntValue("nChs"), N);
+    behaviorChart->reset(N);
+
+    QProgressDialog progress("Quick look...", "Cancel", 0, N, this);
+    progress.setWindowFlags(progress.windowFlags() & ~Qt::WindowContextHelpButtonHint);
+    progress.setWindowModality(Qt::NonModal);
+    progress.setMinimumDuration(0);
+    progress.setValue(0);
+
+    beginBatch(progress);
+    for (int n = 1; n <= N; n++) {
+        scheduler.submit(JobScheduler::Batch, "PREVIEW", [this, n, &progress]() {
+            evalJuliaInt("n", n);
+            STEP00Preview();
+
+            if (scheduler.isCanceled()) {
+                jl_eval_string("foreach( R -> R[ n ] = [ ], ( Cardinality, VoltageShiftDeviation, Empties ) );");
+                return;
+            }
+
+            updateTrend(n, true);
+            progress.setValue(n);
+        });
+    }
+    bool canceled = !scheduler.run();
+    endBatch();
+    progress.setValue(N);
+
+    // A cancelled quick look keeps the results already in the project
+    jl_eval_string("CloseRaw( RAW ); RAW = nothing;");
+    if (!canceled) {
+        jl_eval_string("Empties = sort( unique!( vcat( Empties... ) ) );");
+        jl_eval_string("SaveResults( FILESTEP00, Variables[ \"nChs\" ], N; colormap = cm_, matrices = [ \"Cardinality\" => Cardinality, \"VoltageShiftDeviation\" => VoltageShiftDeviation ], lists = [ \"Empties\" => Empties, \"Preview\" => [ PreviewWindows ] ] );");
+    }
+    jl_eval_string("BINRAW = nothing; BINDIG = nothing; Filter = nothing;");
+
+    QFileInfo fileInfo(juliaStringValue("PATHMAIN"));
+    mainPath = fileInfo.absoluteFilePath();
+
+    if (!canceled) {
+        rebuildAtlas("STEP00");
+    }
+    figuresPath("STEP00");
+    ui->typeOfGraphComboBox->setEnabled(true);
+    ui->buttonBinBehaviour->setEnabled(true);
+
+    // STEP01 and the rebinning need the full STEP00, a quick look has only part of each segment
+    bool preview = previewOnly();
+    ui->buttonStep01->setEnabled(!preview);
+    ui->buttonRebin->setEnabled(!preview);
+}
+
+
+
+// Whether the STEP00 results of the project are those of a quick look
+bool evalRegister::previewOnly()
+{
+    ResultsStore store;
+    qint64 count = 0;
+    return store.open(mainPath + "/Info/STEP00.res") && store.list("Preview", count) != nullptr;
+}
+
+
+
 QString evalRegister::searchInfoBRW()
 {
     QFileInfo fileInfo(mainPath);
@@ -656,7 +1403,7 @@ QString evalRegister::searchInfoBRW()
     }
 
     QStringList nameFilters;
-    nameFilters << "*.jld2";
+    nameFilters << "*.jld2" << "*.res";
 
     QFileInfoList jld2FilesInfo = infoDir.entryInfoList(nameFilters, QDir::Files, QDir::Name);
 
@@ -761,6 +1508,9 @@ void evalRegister::saveToIni()
     settings.setValue("voltageInt", ui->spinBoxVoltageInt->value()); // int
     settings.setValue("maxLim", ui->spinBoxVoltageInt->maximum()); // int
     settings.setValue("limSat", ui->doubleSpinBoxLimSat->value()); // double
+    settings.setValue("filter", ui->filterComboBox->currentText()); // QString
+    settings.setValue("filterLow", ui->filterLowSpinBox->value()); // double
+    settings.setValue("filterHigh", ui->filterHighSpinBox->value()); // double
     settings.setValue("segments", ui->label_N->text()); // QString
     settings.setValue("binSize", ui->label_fs->text()); // QString
     settings.setValue("binTime", ui->label_ft->text()); // QString
@@ -797,6 +1547,14 @@ void evalRegister::loadFromIni()
         ui->colorComboBox->setCurrentIndex(index);
     }
 
+    // The filter cut-offs are restored after the combo box resets them
+    int filterIndex = ui->filterComboBox->findText(settings.value("filter", "None").toString());
+    if (filterIndex != -1) {
+        ui->filterComboBox->setCurrentIndex(filterIndex);
+        ui->filterLowSpinBox->setValue(settings.value("filterLow", ui->filterLowSpinBox->value()).toDouble());
+        ui->filterHighSpinBox->setValue(settings.value("filterHigh", ui->filterHighSpinBox->value()).toDouble());
+    }
+
     // Load Paths
     ui->textFileSelected->setText(settings.value("fileSelected").toString());
     FILEBRW = settings.value("FILEBRW").toString();
@@ -808,47 +1566,108 @@ void evalRegister::loadFromIni()
 
 void evalRegister::codeStep00_saving()
 {
-    jl_eval_string("close( RAW )");
+    jl_eval_string("CloseRaw( RAW ); RAW = nothing;");
+    jl_eval_string("isnothing( Pyramid ) || ClosePyramid!( Pyramid );");
+    jl_eval_string("isnothing( Sketch ) || CloseSketch!( Sketch );");
 
     jl_eval_string("Empties = sort( unique!( vcat( Empties... ) ) );");
-    jl_eval_string("step00 = Dict( \"Cardinality\" => Cardinality, \"VoltageShiftDeviation\" => VoltageShiftDeviation,\"Empties\" => Empties);");
-    jl_eval_string("jldsave( FILESTEP00; Data = step00 );");
+    jl_eval_string("SaveResults( FILESTEP00, Variables[ \"nChs\" ], N; colormap = cm_, matrices = [ \"Cardinality\" => Cardinality, \"VoltageShiftDeviation\" => VoltageShiftDeviation, ( Connectivity ? [ \"LocalCorrelation\" => LocalCorr, \"GlobalCorrelation\" => GlobalCorr ] : [ ] )... ], lists = [ \"Empties\" => Empties ] );");
+
+    // The band, spike and connectivity maps, drawn by the GUI from these stores
+    jl_eval_string("BandResults( PATHINFO, Variables[ \"nChs\" ], N, BandAbs, BandRel, Empties; colormap = cm_ );");
+    jl_eval_string("PairResults( joinpath( PATHINFO, \"SPIKES.res\" ), Variables[ \"nChs\" ], N, [ log10.( F .+ 0.1 ) for F in FiringRate ], SpikeNoise, Empties; colormap = cm_ );");
+    jl_eval_string("FILECONNECTIVITY = joinpath( PATHINFO, \"CONNECTIVITY.res\" );");
+    jl_eval_string("Connectivity ? PairResults( FILECONNECTIVITY, Variables[ \"nChs\" ], N, LocalCorr, GlobalCorr, Empties; colormap = cm_ ) : rm( FILECONNECTIVITY; force = true );");
 
-    jl_eval_string("Parameters = Dict( \"MaxGB\" => MaxGB, \"limSat\" => limSat, \"THR_EMP\" => THR_EMP, \"Δt\" => Δt, \"cm_\" => cm_, \"N\" => N, \"cm_\" => cm_);");
+    jl_eval_string("Parameters = Dict( \"MaxGB\" => MaxGB, \"limSat\" => limSat, \"THR_EMP\" => THR_EMP, \"Δt\" => Δt, \"cm_\" => cm_, \"N\" => N, \"nfrs\" => Variables[ \"SegmentFrames\" ], \"SaveBIN\" => SaveBIN, \"Filter\" => ( FilterKind, FilterLow, FilterHigh ), \"cm_\" => cm_);");
+    jl_eval_string("foreach( k -> haskey( Variables, k ) && ( Parameters[ k ] = Variables[ k ] ), ( \"Window\", \"Channels\" ) );");
     jl_eval_string("jldsave( FILEPARAMETERS; Data = Parameters );");
+    jl_eval_string("jldsave( FILEMEMORY; Data = Dict( \"STEP00\" => MemoryLog ) );");
+    jl_eval_string("RunPeakGB = max( RunPeakGB, RunPeak( MemoryLog ) );");
+    jl_eval_string("CalibrateAmplification!( MemoryLog, RunBaselineGB, Variables[ \"SegmentFrames\" ] * Variables[ \"dsetsize\" ] / Variables[ \"NRecFrames\" ] );");
+    jl_eval_string("jldsave( FILEBANDS; Data = Dict( \"Bands\" => Bands, \"Absolute\" => BandAbs, \"Relative\" => BandRel ) );");
+    jl_eval_string("jldsave( FILESPIKES; Data = Dict( \"FiringRate\" => FiringRate, \"Noise\" => SpikeNoise, \"Times\" => SpikeTimestamps ? SpikeTimes : nothing ) );");
 
     jl_eval_string("BINRAW = nothing;");
+    jl_eval_string("BINDIG = nothing;");
+    jl_eval_string("Pyramid = nothing;");
+    jl_eval_string("Sketch = nothing;");
+    jl_eval_string("Filter = nothing;");
+    jl_eval_string("MemoryLog = nothing;");
     jl_eval_string("Cardinality = nothing;");
     jl_eval_string("VoltageShiftDeviation = nothing;");
+    jl_eval_string("BandAbs = nothing;");
+    jl_eval_string("BandRel = nothing;");
+    jl_eval_string("FiringRate = nothing;");
+    jl_eval_string("SpikeNoise = nothing;");
+    jl_eval_string("SpikeTimes = nothing;");
+    jl_eval_string("LocalCorr = nothing;");
+    jl_eval_string("GlobalCorr = nothing;");
     jl_eval_string("Empties = nothing;");
     jl_eval_string("data = nothing;");
-    jl_eval_string("step00 = nothing;");
     jl_eval_string("Parameters = nothing;");
 
-    jl_eval_string("GC.gc();");
+    jl_eval_string("GC.gc( false );"); // The segments live in the arena, little is left to collect
 }
 
 void evalRegister::codeStep01_saving()
 {
-    jl_eval_string("step01 = Dict( \"Cardinality\" => Cardinality, \"VoltageShiftDeviation\" => VoltageShiftDeviation, \"Sats\" => Sats, \"Repaired\" => Repaired, \"Empties\" => Empties );");
-    jl_eval_string("jldsave( FILESTEP01; Data = step01 );");
+    jl_eval_string("SaveResults( FILESTEP01, Variables[ \"nChs\" ], N; colormap = cm_, matrices = [ \"Cardinality\" => Cardinality, \"VoltageShiftDeviation\" => VoltageShiftDeviation ], tables = [ \"Sats\" => Sats, \"Repaired\" => Repaired ], lists = [ \"Empties\" => Empties ] );");
 
     jl_eval_string("NewParameters = Dict( \"THR_SES\" => THR_SES, \"minchan\" => minchan, \"maxrad\"  => maxrad, \"maxIt\"   => maxIt );");
     jl_eval_string("Parameters = merge( Parameters, NewParameters );");
     jl_eval_string("jldsave( FILEPARAMETERS; Data = Parameters );");
 
+    jl_eval_string("MemoryLogs = isfile( FILEMEMORY ) ? LoadDict( FILEMEMORY ) : Dict( );"); // Not Memory, Base.Memory on Julia >= 1.11
+    jl_eval_string("MemoryLogs[ \"STEP01\" ] = MemoryLog;");
+    jl_eval_string("jldsave( FILEMEMORY; Data = MemoryLogs );");
+    jl_eval_string("RunPeakGB = max( RunPeakGB, RunPeak( MemoryLog ) );");
+    jl_eval_string("CalibrateAmplification!( MemoryLog, RunBaselineGB, Variables[ \"SegmentFrames\" ] * Variables[ \"dsetsize\" ] / Variables[ \"NRecFrames\" ] );");
+
     jl_eval_string("BINRAW = nothing;");
     jl_eval_string("BINPATCH = nothing;");
+    jl_eval_string("Filter = nothing;");
     jl_eval_string("Cardinality = nothing;");
     jl_eval_string("VoltageShiftDeviation = nothing;");
     jl_eval_string("Sats = nothing;");
 
     jl_eval_string("Repaired = nothing;");
-    jl_eval_string("Variables = nothing;");
+    jl_eval_string("MemoryLog = nothing;");
+    jl_eval_string("MemoryLogs = nothing;");
     jl_eval_string("step00 = nothing;");
     jl_eval_string("Parameters = nothing;");
 
-    jl_eval_string("GC.gc();");
+    jl_eval_string("GC.gc( false );"); // The segments live in the arena, little is left to collect
+}
+
+
+
+void evalRegister::memoryTrackStart()
+{
+    jl_eval_string("gc0 = Base.gc_num(); t0 = time_ns(); peak0 = Sys.maxrss();");
+}
+
+QString evalRegister::memoryTrackStop()
+{
+    jl_eval_string("MemoryLog[ n ] = SegmentMemory( gc0, t0, peak0 );");
+    jl_eval_string("MemoryThrottle( MaxGB );");
+
+    float rss = juliaFloatValue("round( MemoryLog[ n ][ \"RSS\" ], digits = 2 )");
+    float peakDelta = juliaFloatValue("round( MemoryLog[ n ][ \"PeakΔ\" ], digits = 2 )");
+    float gcTime = juliaFloatValue("round( MemoryLog[ n ][ \"GCTime\" ], digits = 2 )");
+    return "RSS: " + QString::number(rss) + " GB (peak +" + QString::number(peakDelta) + ") | GC: " + QString::number(gcTime) + " s";
+}
+
+
+
+// Highest RSS of the segments run since the click, not the high-water mark of the session
+QString evalRegister::peakReport()
+{
+    float peak = juliaFloatValue("round( RunPeakGB, digits = 2 )");
+    if (peak <= 0) {
+        return "Results restored from the artifact cache";
+    }
+    return "Peak RSS: " + QString::number(peak) + " GB";
 }
 
 
@@ -864,6 +1683,14 @@ void evalRegister::ButtonOpenExplorer()
         qDebug() << "Error: Figures directory does not exist at specified path.";
     }
 
+    // Composites deferred by STEP01 are drawn now that someone is going to look at them
+    if (!scheduler.isBatchRunning()) {
+        int written = FigureExport::writeComposites(mainPath + "/Info/STEP01.res", figuresPath + "/STEP01");
+        if (written > 0) {
+            qDebug() << "STEP01 figures written: " << written;
+        }
+    }
+
     QString directory = QDir::toNativeSeparators(figuresPath);
     if (directory.isEmpty()) {
         qDebug() << "Error: Failed to convert path to native format.";
@@ -897,6 +1724,8 @@ void evalRegister::setSpectro(const QString &filename)
 {
     QPixmap pic(filename);
 
+    behaviorChart->hide();
+
     if (!pic.isNull()) {
         ui->imgLabel->setPixmap(pic.scaled(ui->imgLabel->size(), Qt::KeepAspectRatioByExpanding, Qt::SmoothTransformation));
     } else {
@@ -906,6 +1735,161 @@ void evalRegister::setSpectro(const QString &filename)
 
 
 
+// Julia state for the spectrograms and traces of a loaded project
+void evalRegister::loadSpec()
+{
+    evalJuliaString("PATHINFO", infoPath);
+
+    // Julia Callings
+    QDir::setCurrent(QCoreApplication::applicationDirPath());
+    jl_eval_string("cd(\"methods/\");");
+    jl_eval_string("include(\"CODE_SPEC.jl\");");
+    specLoaded = true;
+}
+
+
+
+// Before the first spectrogram (clicked or prefetched) of a loaded project; never inside a
+// batch, whose segments run on the Julia state of their own CODE_STEP
+void evalRegister::prepareSpec()
+{
+    if (!specLoaded && !scheduler.isBatchRunning()) {
+        loadSpec();
+    }
+}
+
+
+
+// Shows the clicked channel over the frames of the selected segment
+void evalRegister::showTrace(int channel)
+{
+    prepareSpec();
+
+    // Interactive job: runs now, or at the next poll of a running batch
+    scheduler.submit(JobScheduler::Interactive, "trace", [this, channel]() {
+        QString pyramidPath = mainPath + "/Info/Pyramid.bin";
+
+        if (!traceViewer->openPyramid(pyramidPath)) {
+            qDebug() << "Error: No trace pyramid found: " << pyramidPath;
+            return;
+        }
+
+        // No globals are touched, a batch segment may be halfway through
+        int firstFrame = juliaIntValue("SegmentFrames( Variables, segment, N )[ 1 ]");
+        int lastFrame = juliaIntValue("SegmentFrames( Variables, segment, N )[ 2 ]");
+        traceViewer->showChannel(channel, firstFrame - 1, lastFrame);
+    });
+}
+
+
+
+// The finished column of both metrics, copied while the Julia global keeps it alive; the
+// Raw Bin Behavior follows STEP00 only
+void evalRegister::updateTrend(int n, bool raw)
+{
+    jl_eval_string("trendColumn = Float64.( vcat( vec( Cardinality[ n ] ), vec( VoltageShiftDeviation[ n ] ) ) );");
+
+    if (jl_exception_occurred()) {
+        qDebug() << "Error: No trend column for segment" << n;
+        return;
+    }
+
+    // A segment without results (or of another channel count) would be read past its end
+    int nChs = trendView->channels();
+    if (juliaIntValue("length( trendColumn )") != 2 * nChs) {
+        qDebug() << "Error: Trend column of segment" << n << "does not match" << nChs << "channels";
+        return;
+    }
+
+    jl_value_t *address = jl_eval_string("UInt( pointer( trendColumn ) )");
+    const double *column = reinterpret_cast<const double *>(jl_unbox_uint64(address));
+
+    trendView->setColumn(MapAtlas::Cardinality, n - 1, column);
+    trendView->setColumn(MapAtlas::VoltageShiftDeviation, n - 1, column + nChs);
+
+    if (raw) {
+        behaviorChart->setColumn(MapAtlas::Cardinality, n - 1, column, nChs);
+        behaviorChart->setColumn(MapAtlas::VoltageShiftDeviation, n - 1, column + nChs, nChs);
+    }
+}
+
+
+
+// Both maps show the region, the trend keeps only its channels
+void evalRegister::roiSelected(const QRect &roi)
+{
+    mapRoi = roi;
+    figureViewer->setRoi(roi);
+    figureViewer_STD->setRoi(roi);
+    trendView->setRoi(roi);
+}
+
+
+
+void evalRegister::trendCellSelected(int segment, int channel)
+{
+    if (segment < ui->myComboBox->count()) {
+        ui->myComboBox->setCurrentIndex(segment);
+    }
+
+    figureViewer->markChannel(channel);
+    figureViewer_STD->markChannel(channel);
+}
+
+
+
+// Batch segments share the GUI thread with the clicks on the maps, see JobScheduler
+void evalRegister::beginBatch(QProgressDialog &progress)
+{
+    scheduler.beginBatch();
+    connect(&progress, &QProgressDialog::canceled, &scheduler, &JobScheduler::cancel);
+    evalJulia("SchedulerPoll[ ]", "Ptr{ Cvoid }( " + QString::number(JobScheduler::pollAddress()) + " )");
+
+    // The run reads its parameters from Julia as it goes, edits would only apply to part of it
+    const QList<QWidget *> controls = {
+        ui->maxGBSpinBox, ui->maxGBSlider, ui->spinBoxMinSegments, ui->autotuneCheckBox, ui->colorComboBox,
+        ui->saveBINCheckBox, ui->fuseStep01CheckBox, ui->previewCheckBox, ui->followCheckBox,
+        ui->deferFiguresCheckBox, ui->spikeTimesCheckBox, ui->connectivityCheckBox, ui->filterComboBox,
+        ui->filterLowSpinBox, ui->filterHighSpinBox, ui->windowStartSpinBox, ui->windowEndSpinBox,
+        ui->roiEvalCheckBox, ui->spinBoxVoltageThr, ui->spinBoxVoltageInt, ui->doubleSpinBoxLimSat,
+        ui->spinBoxN1, ui->spinBoxN_overlap, ui->buttonEvaluate, ui->buttonStep01, ui->buttonRebin
+    };
+    for (QWidget *control : controls) {
+        if (control->isEnabled()) {
+            control->setEnabled(false);
+            batchLocked.append(control);
+        }
+    }
+}
+
+void evalRegister::endBatch()
+{
+    jl_eval_string("SchedulerPoll[ ] = C_NULL;");
+    scheduler.endBatch();
+
+    // Only what beginBatch disabled, the rest keeps its own state
+    for (QWidget *control : batchLocked) {
+        control->setEnabled(true);
+    }
+    batchLocked.clear();
+}
+
+
+
+// Closing mid-batch would shut Julia down under the kernels, it cancels first
+void evalRegister::closeEvent(QCloseEvent *event)
+{
+    if (scheduler.isBatchRunning()) {
+        scheduler.cancel();
+        event->ignore();
+        return;
+    }
+
+    QMainWindow::closeEvent(event);
+}
+
+
+
 // Function to jl_eval_string
 void evalRegister::evalJulia(const QString& key, const QString& value) {
     QString evalString = key + " = " + value + ";";
@@ -1,7 +1,18 @@
 #pragma once
 
 #include <QMainWindow>
+#include <QProgressDialog>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <map>
+#include "BehaviorChart.h"
+#include "CompareWindow.h"
 #include "FigureViewer.h"
+#include "JobScheduler.h"
+#include "MapAtlas.h"
+#include "SegmentArena.h"
+#include "TraceViewer.h"
+#include "TrendView.h"
 
 QT_BEGIN_NAMESPACE
     namespace Ui { class evalRegister; }
@@ -17,29 +28,62 @@ public:
 
     // Public Funcions
     void setSpectro(const QString &filename);
+    void showTrace(int channel);
+    void prepareSpec();
+
+protected:
+    void closeEvent(QCloseEvent *event) override;
 
 private slots:
     void actionOpenTriggered();
     void actionLoadTriggered();
+    void actionCompareTriggered();
     void actionExitTriggered();
     void ComboBoxCurrentTextChanged(const QString &arg1);
     void typeOfGraphComboBoxTextChanged(const QString &arg1);
+    void filterComboBoxTextChanged(const QString &arg1);
     void colorComboBoxTextChanged(const QString &arg1);
     void ButtonEvaluateClicked();
     void ButtonBinBehavior();
+    void ButtonRebinClicked();
     void ButtonStep01Clicked();
     void ButtonOpenExplorer();
     void SpinBoxN1ValueChanged(int arg1);
     void SpinBoxNoverLapValueChanged(int arg1);
+    void SegmentSliderValueChanged(int value);
+    void ButtonPlayClicked();
+    void PlayTimerTimeout();
+    void roiSelected(const QRect &roi);
+    void trendCellSelected(int segment, int channel);
 
 private:
     Ui::evalRegister *ui;
     FigureViewer *figureViewer; // Obj. to call our signal or slots?!?!?
     FigureViewer *figureViewer_STD; // Yes, it is to call our signal and slots :)
+    TraceViewer *traceViewer;
+    TrendView *trendView;
+    BehaviorChart *behaviorChart;
+    CompareWindow *compareWindow = nullptr;
 
     // Auxiliar Functions
     void figuresPath(const QString &figures);
+    void rebuildAtlas(const QString &figures);
+    void closeAtlases();
+    void loadSpec();
+    void beginBatch(QProgressDialog &progress);
+    void endBatch();
+    void updateTrend(int n, bool raw);
     void STEP00();
+    void STEP00Preview();
+    void evaluatePreview(int N);
+    void evaluateFollow();
+    bool followNext(QProgressDialog &progress, QElapsedTimer &idle);
+    bool runStep00(int N);
+    bool runStep01();
+    QStringList step00Artifacts(const QString &project);
+    void finishStep00(bool canceled);
+    bool previewOnly();
+    void step00Figure(const QString &metric, const QString &suffix);
     void STEP01();
     QString searchInfoBRW();
     QString loadPathFromFile(const QString &key);
@@ -59,10 +103,34 @@ private:
     // Julia auxiliar functions
     void codeStep00_saving();
     void codeStep01_saving();
+    void memoryTrackStart();
+    QString memoryTrackStop();
+    QString peakReport();
 
     // Auxiliar Variables
     double initialSpinValue;
 
+    // Maps of each step and band, memory-mapped
+    std::map<QString, MapAtlas> atlases;
+    MapAtlas *atlas = nullptr;
+    QTimer *playTimer;
+
+    // Segment buffers shared with Julia
+    SegmentArena arena;
+
+    // Batch segments and interactive requests on the GUI thread
+    JobScheduler scheduler;
+    QList<QWidget *> batchLocked; // Controls disabled while a batch runs
+
+    // Region dragged on the maps, 64x64 pixels, empty for the whole array
+    QRect mapRoi;
+
+    // Fingerprint of the BRW, the artifact cache keys start with it (empty while following)
+    QString recordingId;
+
+    // CODE_SPEC.jl is included on demand after a load
+    bool specLoaded = false;
+
     // Auxiliar Const
     const int scaleFactor = 100;
 
@@ -16,12 +16,14 @@ module AllSTEPs
 # ----------------------------------------------------------------------------------------- #
 using Dates
 using DSP
+using FFTW
 using HDF5
 using InteractiveUtils
 using JLD2
+using LinearAlgebra
 using Measures
+using Mmap
 using Plots
-using Primes
 using StatsBase
 using Suppressor
 # ----------------------------------------------------------------------------------------- #
@@ -33,18 +35,38 @@ using Suppressor
 export FindDirsFiles
 export GetVarsHDF5
 export GetChunkSize
+export SegmentFrames
+export Restrict!
+export ExpandChannels
+export RecordedFrames
+export FollowFrames
+export Follow!
+export SegmentSlots!
 export ChunkSizeSpace
+export OpenRaw
+export CloseRaw
+export FileLocking!
 export OneSegment
+export PreviewSegment
 export Digital2Analogue
+export Digital2Analogue!
+export ArenaMatrix
 export SupInfThr
 export UniqueCount
 export STDΔV
 export ms2frs
+export OpenPyramid
+export AddPyramid!
+export ClosePyramid!
+export TraceSamples
     # STEP01
 export SearchDir
 export LoadDict
+export LoadSegment
+export LoadSegment!
 export BarPlot
 export SupThr
+export ReconstructEmpties!
 export ReduceArrayDistance
 export Neighbours
 export ReconstructChannels
@@ -52,9 +74,55 @@ export PatchEmpties
 export Zplot
     # Jorgio functions
 export Channel_Spectrogram
+export SpectrogramBands
+export SpectrogramSeries
+    # Results store
+export SaveResults
+export StepResults
+export ArtifactParameters
+export ArtifactVersion
+    # Segment sketches
+export OpenSketch
+export AddSketch!
+export CloseSketch!
+export SketchInfo
+export RebinSketch
+export RebinResults
+    # Channel pool
+export ChannelBlock
+export ForChannels
+export SchedulerPoll
+export Cancelled
+export PollScheduler
+export CheckCancel
+    # Band power
+export Bands
+export BandPower
+export BandResults
+export PairResults
+    # Spikes
+export SpikeDetect
+    # Connectivity
+export ChannelCorrelation
+    # Filter bank
+export FilterBank
+export FilterDesign
+export FilterSegment!
     # aux
 export convgauss
 export RemoveInfs
+export ZscoreFinite
+    # Memory
+export MemoryAmplification
+export Amplification
+export CalibrateAmplification!
+export RunPeak
+export SegmentBudget
+export EstimateMemory
+export AutotuneSegments
+export SegmentMemory
+export CurrentRSS
+export MemoryThrottle
 # ----------------------------------------------------------------------------------------- #
 
 # ----------------------------------------------------------------------------------------- #
@@ -661,6 +729,8 @@ function GetVarsHDF5( FILEBRW::String )
             Variables[ "NRecFrames" ] = size( dset, 1 ) / Variables[ "nChs" ];
         end
     end
+    # Frames spanned by one HDF5 chunk, to align the segments with the file layout.
+    Variables[ "ChunkFrames" ] = ChunkFrames( dset, Variables[ "nChs" ] );
     # Calculate the BWR time based on the number of frames and sampling rate.
     BRWTIME = round(
         ( Variables[ "NRecFrames" ] / Variables[ "SamplingRate" ] ), digits = 3 );
@@ -705,81 +775,360 @@ function GetVarsHDF5( FILEBRW::String )
 end
 
 """
-    GetChunkSize( Variables::Dict, MaxGB::Real = 0.5, m::Int = 3, M::Int = 500 ) → σ::Int
-        Determines the optimal number of segments for a dataset such that each segment's size
-        does not exceed `MaxGB`. It also ensures that the number of segments falls within the
-        range specified by `m` and `M`, where `m` is the minimum and `M` is the maximum
-        number of segments allowed. If a suitable number of segments cannot be determined,
-        defaults to dividing the dataset into segments of 4 seconds each.
+    GetChunkSize( Variables::Dict, MaxGB::Real = 0.5, m::Int = 3, M::Int = 500; frames::Int = 0 ) → σ::Int
+        Determines the number of segments for a dataset such that the whole process stays
+        within the memory budget `MaxGB`, with every segment boundary aligned to the on-disk
+        HDF5 chunks of the raw dataset. It also ensures that the number of segments falls
+        within the range specified by `m` and `M`, where `m` is the minimum and `M` is the
+        maximum number of segments allowed. The recording is never truncated: the last
+        segment takes whatever frames remain.
 
         **Purpose**
         This function calculates how to partition a dataset into manageable segments based on
-        its size and specified constraints. It helps in managing large datasets by ensuring
-        that each segment is of a feasible size for processing or analysis, while also
-        adhering to constraints on the number of segments.
+        its size, its chunk layout and the specified constraints. Reading whole chunks means
+        every chunk is decompressed exactly once, so a sequential pass over the segments runs
+        at the throughput the file layout allows.
 
         **Inputs**
         - `Variables`: A dictionary containing metadata about the hdf5 original file,
             including:
             - `"NRecFrames"`: Total number of frames in the dataset.
             - `"dsetsize"`: Size of the dataset in gigabytes.
-            - `"nChs"`: Number of channels in the dataset.
             - `"SamplingRate"`: Sampling rate of the dataset.
-        - `MaxGB`: The maximum allowed size for each segment in gigabytes (default is 0.5 GB)
+            - `"ChunkFrames"`: Frames spanned by one HDF5 chunk ( 1 when contiguous ).
+            - `"Window"`: Frames to evaluate, when `Restrict!` limited them.
+        - `MaxGB`: The process memory budget in gigabytes (default is 0.5 GB). The raw size
+            allowed for each segment is derived from it with `SegmentBudget`.
         - `m`: Minimum number of segments (default is 3).
         - `M`: Maximum number of segments (default is 500).
+        - `frames`: Frames of each segment when `AutotuneSegments` chose them, 0 to derive
+            them from `MaxGB`.
+        - `minframes`: A last segment shorter than this is always folded into the previous
+            one, even past `MaxGB` ( e.g. twice the shift of the VSD, which a shorter segment
+            could not be evaluated with ).
 
         **Outputs**
-        - `σ`: The number of segments that meet the size constraints.
+        - `σ`: The number of segments. The frames of each regular segment are stored in
+            `Variables[ "SegmentFrames" ]`, which `SegmentFrames` and `OneSegment` use.
+        - `ft`, `fs`: Duration ( s ) and size ( GB ) of each regular segment.
+        - `flagQtUI`: 1 when `MaxGB` or the chunk layout could not be honored and the segment
+            size had to be adjusted.
 
         **Requirements**
-        - **Native Modules**: `Primes`
+        - **Custom Functions**: `SegmentBudget`
 """
-function GetChunkSize( Variables::Dict, MaxGB::Real = 0.5, m::Int = 3, M::Int = 500 )
+function GetChunkSize( Variables::Dict, MaxGB::Real = 0.5, m::Int = 3, M::Int = 500; frames::Int = 0, minframes::Int = 0 )
     flagQtUI = 0;
+    # Translate the process budget into the maximum raw size of one segment
+    MaxGB = SegmentBudget( MaxGB );
     # Retrieve dataset properties from the Variables dictionary
-    NRecFrames = Variables[ "NRecFrames" ];
+    NRecFrames = Int( Variables[ "NRecFrames" ] );
     dsetsize = Variables[ "dsetsize" ];
-    nChs = Variables[ "nChs" ];
     SamplingRate = Variables[ "SamplingRate" ];
-    # Calculate the size of one frame in gigabytes
-    onenumber = dsetsize / ( NRecFrames * nChs );
-    # Adjust the number of frames to avoid prime values
-    while isprime( NRecFrames )
-        NRecFrames -= 1;
-        dsetsize -= onenumber;
-    end
-    # Find divisors of the number of frames within the specified range
-    divs = divisors( NRecFrames );
-    divs = divs[ divs .>= m .&& divs .<= M ];
-    # Calculate the size of each segment for the valid divisors
-    aux = dsetsize ./ divs;
-    aux = aux[ aux .<= MaxGB ];
-    finalsize = 0;
-    σ = 0;
-    # Determine if a suitable segment size is found
-    if isempty( aux )
+    cf = get( Variables, "ChunkFrames", 1 );
+    # Size of one frame ( all channels ) in gigabytes
+    oneframe = dsetsize / NRecFrames;
+    # Only the frames of the window are segmented ( Restrict! )
+    fw0, fwN = get( Variables, "Window", ( 1, NRecFrames ) );
+    NRecFrames = fwN - fw0 + 1;
+    nfrs = frames;
+    # Try the chunk granularity first; whole frames only if the chunks are too coarse
+    for g in unique( [ cf, 1 ] )
+        nfrs > 0 && break
+        nChunks = cld( NRecFrames, g );
+        k = floor( Int, MaxGB / ( oneframe * g ) ); # Chunks per segment allowed by MaxGB
+        kmax = fld( nChunks, m );                    # At least m segments
+        kmin = cld( nChunks, M );                    # At most M segments
+        if k >= 1 && kmax >= 1 && kmin <= kmax
+            nfrs = clamp( k, kmin, kmax ) * g;
+            flagQtUI = Int( k < kmin || g != cf );
+            break
+        end
+    end
+    if nfrs == 0
         flagQtUI = 1;
-        m1 = "No optimal segment size has been found for the 'MaxGB' value. ";
-        m2 = "Using default segment length of 4 seconds.";
-        println( m1, m2 );
-        σ = floor( Int, NRecFrames / SamplingRate * 4 ); # Default to 4 seconds per segment
-        nfrs = floor( Int, NRecFrames / σ );
-        NRecFrames = Int( nfrs * σ );
-        finalsize = nfrs * nChs * onenumber;
-    else
-        finalsize = maximum( aux );
-        σ = Int( dsetsize / finalsize );
+        nfrs = max( 1, fld( NRecFrames, max( m, 1 ) ) );
     end
-    # Calculate the time duration of each segment
-    finaltime = ( ( NRecFrames / σ ) / SamplingRate );  # in seconds
-    fs = round( finalsize, digits = 3 );  # Size of each segment in GB
-    ft = round( finaltime, digits = 3 );  # Duration of each segment in seconds
+    if flagQtUI == 1
+        println( "No chunk-aligned segment size fits the 'MaxGB' value, using $nfrs frames." );
+    end
+    σ = cld( NRecFrames, nfrs );
+    # A tail shorter than half a segment is folded into the previous segment, as long as that
+    # longer last segment still fits the budget; otherwise it stays a short segment of its own.
+    # One shorter than `minframes` is folded regardless, a few frames more than the budget
+    # weigh less than a segment too short for the VSD shift
+    tail = NRecFrames - ( σ - 1 ) * nfrs;
+    if σ > 1 && ( tail < minframes || ( tail < nfrs / 2 && ( nfrs + tail ) * oneframe <= MaxGB ) )
+        σ -= 1;
+    end
+    Variables[ "SegmentFrames" ] = nfrs;
+    # Calculate the time duration and size of each segment
+    fs = round( nfrs * oneframe, digits = 3 );  # Size of each segment in GB
+    ft = round( nfrs / SamplingRate, digits = 3 );  # Duration of each segment in seconds
     # Print segment information
-    println( "$σ segments of $fs GB and $ft seconds each" );
+    println( "$σ segments of $fs GB and $ft seconds each ( $cf frames per HDF5 chunk )" );
     return σ, ft, fs, flagQtUI
 end
 
+"""
+    SegmentFrames( Variables::Dict, n::Int, N::Int ) → fr0::Int, frN::Int
+        First and last frame of the n-th of `N` segments. Regular segments span
+        `Variables[ "SegmentFrames" ]` frames; the last one runs to the end of the recording,
+        or of the window set by `Restrict!`.
+"""
+function SegmentFrames( Variables::Dict, n::Int, N::Int )
+    fw0, fwN = get( Variables, "Window", ( 1, Int( Variables[ "NRecFrames" ] ) ) );
+    nfrs = get( Variables, "SegmentFrames", floor( Int, ( fwN - fw0 + 1 ) / N ) );
+    fr0 = fw0 + ( n - 1 ) * nfrs;
+    frN = n == N ? fwN : fw0 + n * nfrs - 1;
+    return fr0, frN
+end
+
+"""
+    Restrict!( Variables::Dict, t0::Real, t1::Real, Channels::Vector{ Int } = Int[ ] ) → Variables::Dict
+        Limits the evaluation to the seconds [ t0, t1 ] of the recording and to some channels.
+
+        **Purpose**
+        A quick look at a window of a long recording, or at one region of the array, should
+        not read the rest of it. The window is widened to whole HDF5 chunks and stored as
+        `Variables[ "Window" ]`; `GetChunkSize` and `SegmentFrames` only segment its frames,
+        so `OneSegment` reads only them. The channels are stored as `Variables[ "Channels" ]`:
+        `OneSegment` keeps only their rows ( one hyperslab per run of consecutive channels
+        when the dataset is nChs × frames ), the kernels run on those rows and
+        `ExpandChannels` puts the results back in the layout of the array.
+
+        **Inputs**
+        - `Variables`: Dictionary with the metadata of the BRW file.
+        - `t0`, `t1`: Window in seconds, `t1 = 0` for the end of the recording.
+        - `Channels`: Channels to evaluate ( 1-based ), empty for all of them.
+
+        **Outputs**
+        - `Variables`: Without `"Window"` or `"Channels"` when they cover the whole recording.
+"""
+function Restrict!( Variables::Dict, t0::Real, t1::Real, Channels::Vector{ Int } = Int[ ] )
+    NRecFrames = Int( Variables[ "NRecFrames" ] );
+    nChs = Variables[ "nChs" ];
+    fs = Variables[ "SamplingRate" ];
+    cf = get( Variables, "ChunkFrames", 1 );
+    fr0 = clamp( floor( Int, t0 * fs ) + 1, 1, NRecFrames );
+    frN = t1 > 0 ? clamp( ceil( Int, t1 * fs ), fr0, NRecFrames ) : NRecFrames;
+    fr0 = fld( fr0 - 1, cf ) * cf + 1;
+    frN = min( cld( frN, cf ) * cf, NRecFrames );
+    delete!( Variables, "Window" );
+    delete!( Variables, "Channels" );
+    if fr0 > 1 || frN < NRecFrames
+        Variables[ "Window" ] = ( fr0, frN );
+    end
+    Channels = sort( unique( filter( c -> 1 <= c <= nChs, Channels ) ) );
+    if !isempty( Channels ) && length( Channels ) < nChs
+        Variables[ "Channels" ] = Channels;
+    end
+    return Variables
+end
+
+# Consecutive channels as ranges, one hyperslab each
+function ChannelRuns( Channels::Vector{ Int } )
+    runs = UnitRange{ Int }[ ];
+    for c in Channels
+        if !isempty( runs ) && last( runs[ end ] ) == c - 1
+            runs[ end ] = first( runs[ end ] ):c;
+        else
+            push!( runs, c:c );
+        end
+    end
+    return runs
+end
+
+"""
+    ExpandChannels( X::VecOrMat, Variables::Dict ) → Y::VecOrMat
+        Rows of the channels kept by `Restrict!` back in their place among all the channels of
+        the array: NaN ( or empty vectors ) for the others. `X` itself when no channel was left out.
+"""
+function ExpandChannels( X::AbstractVecOrMat, Variables::Dict )
+    haskey( Variables, "Channels" ) || return X
+    nChs = Variables[ "nChs" ];
+    if eltype( X ) <: Real
+        Y = fill( NaN, nChs, size( X, 2 ) );
+    else
+        Y = [ eltype( X )( ) for _ in 1:nChs, _ in 1:size( X, 2 ) ];
+    end
+    Y[ Variables[ "Channels" ], : ] = X;
+    return X isa AbstractVector ? vec( Y ) : Y
+end
+ExpandChannels( X::Nothing, Variables::Dict ) = nothing;
+
+"""
+    RecordedFrames( RAW, Variables::Dict ) → frames::Int
+        Frames written so far to the raw dataset of a recording that is still growing. `RAW`
+        is the dataset kept open as a SWMR reader ( `OpenRaw( ...; swmr = true )` ): its
+        metadata is refreshed ( H5Drefresh ) instead of opening the file again next to the
+        handle, which HDF5 does not allow while a writer holds it.
+"""
+function RecordedFrames( RAW::HDF5.Dataset, Variables::Dict )
+    HDF5.API.h5d_refresh( RAW );
+    return length( RAW ) ÷ Variables[ "nChs" ]
+end
+RecordedFrames( RAW::Array, Variables::Dict ) = length( RAW ) ÷ Variables[ "nChs" ];
+
+"""
+    FollowFrames( Variables::Dict, seconds::Real, MaxGB::Real ) → nfrs::Int
+        Frames of every segment of a recording that is still growing: `seconds` in whole HDF5
+        chunks, fewer if `MaxGB` does not allow them ( as in `GetChunkSize` ).
+"""
+function FollowFrames( Variables::Dict, seconds::Real, MaxGB::Real )
+    cf = get( Variables, "ChunkFrames", 1 );
+    oneframe = Variables[ "nChs" ] * sizeof( UInt16 ) / ( 1024 ^ 3 );
+    k = min( cld( ms2frs( 1000 * seconds, Variables ), cf ), floor( Int, SegmentBudget( MaxGB ) / ( oneframe * cf ) ) );
+    return max( k, 1 ) * cf
+end
+
+"""
+    Follow!( Variables::Dict, nfrs::Int, RAW ) → N::Int
+        Complete segments of `nfrs` frames recorded so far in the open dataset `RAW`.
+
+        **Purpose**
+        `GetChunkSize` fixes the segments of a finished recording. While the recording is
+        still being written, the segments have a fixed length instead and their number grows.
+        `Variables[ "Window" ]` ends at the last complete segment, so `SegmentFrames` and
+        `OneSegment` give every segment the frames it had when it was processed. The frames
+        after it wait for the next call. A window chosen by the user would be replaced, the
+        GUI does not follow with one.
+"""
+function Follow!( Variables::Dict, nfrs::Int, RAW )
+    frames = RecordedFrames( RAW, Variables );
+    N = fld( frames, nfrs );
+    Variables[ "NRecFrames" ] = frames;
+    Variables[ "SegmentFrames" ] = nfrs;
+    N > 0 && ( Variables[ "Window" ] = ( 1, N * nfrs ) );
+    return N
+end
+
+"""
+    SegmentSlots!( N::Int, R::Vector... ) → nothing
+        Per-segment result vectors ( `Cardinality`, `Empties`, ... ) resized to N entries, the
+        new ones empty as in CODE_STEP_00.
+"""
+function SegmentSlots!( N::Int, R::Vector... )
+    for r in R
+        k = length( r );
+        resize!( r, N );
+        foreach( i -> r[ i ] = [ ], ( k + 1 ):N );
+    end
+    return nothing
+end
+
+"""
+    ChunkFrames( dset::HDF5.Dataset, nChs::Int ) → cf::Int
+        Number of frames spanned by one HDF5 chunk of the raw dataset, so that segment
+        boundaries at multiples of `cf` never split a chunk. Returns 1 for contiguous datasets.
+"""
+function ChunkFrames( dset::HDF5.Dataset, nChs::Int )
+    chunk = try
+        HDF5.get_chunk( dset );
+    catch e
+        return 1
+    end
+    if length( chunk ) == 2
+        # nChs x frames layout: the second dimension runs over frames
+        return Int( chunk[ 2 ] );
+    else
+        # Flat layout: chunks hold samples, frames hold nChs samples
+        return Int( lcm( chunk[ 1 ], nChs ) ÷ nChs );
+    end
+end
+
+"""
+    OpenRaw( Variables::Dict; sequential::Bool = true, swmr::Bool = false ) → RAW::Union{ Array{ UInt16 }, HDF5.Dataset }
+        Opens the raw dataset of the BRW file, memory-mapped when its layout allows it.
+
+        **Purpose**
+        When the raw dataset is stored contiguously and uncompressed, HDF5 only adds copies
+        and a type conversion on every read. In that case the file is mapped at the offset of
+        the dataset ( `HDF5.readmmap` ) and the kernel is told the access is sequential, so it
+        reads ahead on its own. Otherwise the dataset is returned as before. Either way
+        `OneSegment` hands out the segments, and `CloseRaw` releases the file.
+
+        **Inputs**
+        - `Variables`: Dictionary with `BRWNAME` and the path of the `RAW` dataset.
+        - `sequential`: Whether the mapping is advised for a front-to-back scan.
+        - `swmr`: Open as a SWMR reader, for a file that is still being written ( `Follow!` ).
+
+        **Outputs**
+        - `RAW`: The mapped array ( same shape as the dataset ) or the open HDF5 dataset.
+
+        **Requirements**
+        - **Native Modules**: `HDF5`, `Mmap`
+"""
+function OpenRaw( Variables::Dict; sequential::Bool = true, swmr::Bool = false )
+    BRW = h5open( Variables[ "BRWNAME" ], "r"; swmr = swmr );
+    RAW = BRW[ Variables[ "RAW" ] ];
+    if eltype( RAW ) == UInt16 && HDF5.ismmappable( RAW )
+        M = HDF5.readmmap( RAW );
+        close( RAW );
+        close( BRW );
+        sequential && Advise( M, 1, length( M ), :sequential );
+        return M
+    end
+    return RAW
+end
+
+# The HDF5_USE_FILE_LOCKING of the session while `FileLocking!` has locking off, missing otherwise
+const SessionLocking = Ref{ Any }( missing );
+
+"""
+    FileLocking!( on::Bool ) → nothing
+        HDF5 file locking of the files opened from now on ( HDF5 reads HDF5_USE_FILE_LOCKING at
+        every open ). Off while following a recording whose writer holds its lock; on again
+        puts back whatever the session had, set or not.
+"""
+function FileLocking!( on::Bool )
+    if !on
+        ismissing( SessionLocking[ ] ) && ( SessionLocking[ ] = get( ENV, "HDF5_USE_FILE_LOCKING", nothing ) );
+        ENV[ "HDF5_USE_FILE_LOCKING" ] = "FALSE";
+    elseif !ismissing( SessionLocking[ ] )
+        previous = SessionLocking[ ];
+        isnothing( previous ) ? delete!( ENV, "HDF5_USE_FILE_LOCKING" ) : ( ENV[ "HDF5_USE_FILE_LOCKING" ] = previous );
+        SessionLocking[ ] = missing;
+    end
+    return nothing
+end
+
+"""
+    CloseRaw( RAW ) → nothing
+        Closes the dataset and its file. A mapping is released by the GC once no segment
+        refers to it.
+"""
+function CloseRaw( RAW::HDF5.Dataset )
+    BRW = HDF5.file( RAW );
+    close( RAW );
+    close( BRW );
+    return nothing
+end
+CloseRaw( RAW::Array ) = nothing
+
+"""
+    Advise( RAW::Array, first::Int, last::Int, advice::Symbol ) → nothing
+        `madvise` over the pages holding RAW[ first:last ] ( `:sequential`, `:willneed` or
+        `:dontneed` ). Pages shared with the neighbouring elements are only dropped when
+        they are fully inside the range. No-op outside Unix.
+"""
+function Advise( RAW::Array, first::Int, last::Int, advice::Symbol )
+    Sys.isunix( ) || return nothing
+    flag = advice == :sequential ? Mmap.MADV_SEQUENTIAL :
+           advice == :willneed ? Mmap.MADV_WILLNEED : Mmap.MADV_DONTNEED;
+    page = UInt( Mmap.PAGESIZE );
+    a = UInt( pointer( RAW, first ) );
+    b = UInt( pointer( RAW, last ) ) + sizeof( eltype( RAW ) );
+    if advice == :dontneed
+        a = cld( a, page ) * page;
+        b = fld( b, page ) * page;
+    else
+        a = fld( a, page ) * page;
+    end
+    b > a && ccall( :madvise, Cint, ( Ptr{ Cvoid }, Csize_t, Cint ), Ptr{ Cvoid }( a ), b - a, flag );
+    return nothing
+end
+
 """
     OneSegment( RAW::HDF5.Dataset, Variables::Dict, n::Int, N::Int ) → BIN::Array{ UInt16 }
         Extracts the n-th segment from the provided dataset and returns it as a 2D array.
@@ -797,24 +1146,37 @@ end
             - `"NRecFrames"`: The total number of recording frames in the dataset.
             - `"nChs"`: The number of channels in the dataset.
         - `n`: The index of the segment to be extracted (1-based).
-        - `N`: The total number of segments the dataset is divided into.
+        - `N`: The total number of segments the dataset is divided into. The frame range
+            comes from `SegmentFrames`, so the last segment may be shorter or longer.
 
         **Outputs**
         - `BIN`: A 2D array of type `UInt16` representing the extracted segment, with
             dimensions `[nChs, nfrs]`, where `nChs` is the number of channels and `nfrs` is 
-            the number of frames in the segment.
+            the number of frames in the segment. Only the rows of `Variables[ "Channels" ]`
+            when `Restrict!` set them.
 
         **Requirements**
         - The dataset `RAW` must already be loaded before calling the function, either in the
           form of an array or a view of an HDF5 dataset.
+        - With a memory-mapped `RAW` ( `OpenRaw` ) the segment is a view into the mapping,
+          only valid while `RAW` is alive.
 """
 
 function OneSegment( RAW::HDF5.Dataset, Variables::Dict, n::Int, N::Int )
+    # Frame range of the n-th segment, aligned to the HDF5 chunks by GetChunkSize
+    return FrameRange( RAW, Variables, SegmentFrames( Variables, n, N )... )
+end
+
+"""
+    FrameRange( RAW, Variables::Dict, fr0::Int, frN::Int ) → BIN::Matrix{ UInt16 }
+        Frames `fr0:frN` of the raw dataset as an nChs × frames array ( only the rows of
+        `Variables[ "Channels" ]` when `Restrict!` set them ). From a mapping it is a copy.
+"""
+function FrameRange( RAW::HDF5.Dataset, Variables::Dict, fr0::Int, frN::Int )
     # Extract metadata from the Variables dictionary
     NRecFrames = Variables[ "NRecFrames" ]; # Total number of recording frames in the dataset
     nChs = Variables[ "nChs" ];             # Number of channels in the dataset
-    # Determine the number of frames per segment by dividing total frames by N segments
-    nfrs = floor( Int, ( NRecFrames / N ) ); # nfrs: Number of frames in each segment
+    nfrs = frN - fr0 + 1; # nfrs: Number of frames requested
     # Initialize the BIN array, which will store the extracted segment
     # Attempt to retrieve the dimensions of the dataset (RAW)
     # RAW can either be a 2D array (channels x frames) or a 1D array (frames x channels)
@@ -830,24 +1192,94 @@ function OneSegment( RAW::HDF5.Dataset, Variables::Dict, n::Int, N::Int )
     # Extract the n-th segment based on the dataset format
     if nchs == nChs && nchs != 0
         # Case 1: Dataset has an nChs x nFrs form (older format with separate channels)
-        # Calculate frame range for the n-th segment
-        fr0 = ( ( n - 1 ) * nfrs ) + 1; # Start frame index for the n-th segment
-        frN = n * nfrs; # End frame index for the n-th segment
-        # Extract frames from RAW for all channels between fr0 and frN
-        BIN = view( RAW, 1:nChs, fr0:frN );
+        # Read the frames of all channels between fr0 and frN as one hyperslab, or one per run
+        # of channels kept by Restrict!
+        if haskey( Variables, "Channels" )
+            BIN = vcat( [ RAW[ r, fr0:frN ] for r in ChannelRuns( Variables[ "Channels" ] ) ]... );
+        else
+            BIN = RAW[ 1:nChs, fr0:frN ];
+        end
     elseif nFrs == ( NRecFrames * nChs ) && nFrs != 0
         # Case 2: Dataset is in vector form (newer format where all frames are stored as a 
         # single array)
         # Instead of looping through frames, use reshape to extract the segment
-        init = ( n - 1 ) * nfrs * nChs + 1;  # Starting index for the n-th segment
-        endit = n * nfrs * nChs;              # Ending index for the n-th segment
+        init = ( fr0 - 1 ) * nChs + 1;  # Starting index for the n-th segment
+        endit = frN * nChs;              # Ending index for the n-th segment
         # Extract and reshape into [nChs, nfrs] format
         BIN = reshape( RAW[ init:endit ], nChs, nfrs );
+        # The channels of a frame are contiguous, the frames are read whole
+        haskey( Variables, "Channels" ) && ( BIN = BIN[ Variables[ "Channels" ], : ] );
     end
     # Return the extracted segment as a 2D, UInt16 array
     return BIN
 end
 
+function FrameRange( RAW::Array{ UInt16 }, Variables::Dict, fr0::Int, frN::Int )
+    nChs = Variables[ "nChs" ];
+    W = unsafe_wrap( Array, pointer( RAW, ( fr0 - 1 ) * nChs + 1 ), ( nChs, frN - fr0 + 1 ) );
+    return haskey( Variables, "Channels" ) ? W[ Variables[ "Channels" ], : ] : copy( W )
+end
+
+"""
+    PreviewSegment( RAW, Variables::Dict, n::Int, N::Int, Δt::Real; windows::Int = 8 ) ⤵
+        → BIN::Matrix{ UInt16 }, w::Int
+
+        `windows` evenly spaced runs of `w` frames of the n-th segment, side by side.
+
+        **Purpose**
+        A quick look at every segment before a full Evaluate. Each run starts on a chunk
+        boundary and spans whole HDF5 chunks, so only those chunks are read and decompressed,
+        and it is long enough for a few shifts of Δt. The read and the kernels shrink by the
+        ratio of `windows * w` to the frames of the segment. The kernels see the runs as one
+        short segment: saturations and Cardinality are counted over the sampled frames and
+        `STDΔV` with `window = w` keeps the shifts inside each run. A segment too short for
+        the runs is returned whole.
+
+        **Inputs**
+        - `RAW`: Dataset or mapping from `OpenRaw`.
+        - `Variables`: Dictionary with the metadata of the BRW file ( `"ChunkFrames"` ).
+        - `n`, `N`: Segment and number of segments, as in `OneSegment`.
+        - `Δt`: Shift of the VSD in ms.
+        - `windows`: Runs sampled per segment.
+
+        **Outputs**
+        - `BIN`: nChs × ( `windows * w` ) ADC codes.
+        - `w`: Frames of each run.
+
+        **Requirements**
+        - **Custom Functions**: `SegmentFrames`, `FrameRange`, `ms2frs`
+"""
+function PreviewSegment( RAW, Variables::Dict, n::Int, N::Int, Δt::Real; windows::Int = 8 )
+    cf = get( Variables, "ChunkFrames", 1 );
+    fr0, frN = SegmentFrames( Variables, n, N );
+    nfrs = frN - fr0 + 1;
+    w = cld( 4 * ms2frs( Δt, Variables ) + 1, cf ) * cf;
+    if windows * w >= nfrs
+        return FrameRange( RAW, Variables, fr0, frN ), nfrs
+    end
+    # Segments start on chunk boundaries, and the starts are floored to whole chunks: the
+    # runs never overlap since w is a whole number of chunks
+    Starts = [ fr0 + fld( round( Int, k * ( nfrs - w ) / max( windows - 1, 1 ) ), cf ) * cf for k in 0:( windows - 1 ) ];
+    return reduce( hcat, [ FrameRange( RAW, Variables, a, a + w - 1 ) for a in Starts ] ), w
+end
+
+function OneSegment( RAW::Array{ UInt16 }, Variables::Dict, n::Int, N::Int )
+    nChs = Variables[ "nChs" ];
+    fr0, frN = SegmentFrames( Variables, n, N );
+    # Frames are contiguous in both the nChs x frames and the flat layouts
+    init = ( fr0 - 1 ) * nChs + 1;
+    endit = frN * nChs;
+    Advise( RAW, init, endit, :willneed );
+    if n > 1
+        pr0, prN = SegmentFrames( Variables, n - 1, N );
+        Advise( RAW, ( pr0 - 1 ) * nChs + 1, prN * nChs, :dontneed );
+    end
+    # A window of the mapping, no copy: RAW must outlive the segment
+    W = unsafe_wrap( Array, pointer( RAW, init ), ( nChs, frN - fr0 + 1 ) );
+    # Only the rows kept by Restrict! are copied, the pages of a frame are read whole
+    return haskey( Variables, "Channels" ) ? W[ Variables[ "Channels" ], : ] : W
+end
+
 """
     Digital2Analogue( Variables::Dict, DigitalValue::Matrix{ UInt16 } ) ⤵
         → BIN::Matrix{ Float64 }
@@ -881,6 +1313,14 @@ end
         external packages.
 """
 function Digital2Analogue( Variables::Dict, DigitalValue::Matrix{ UInt16 } )
+    return Digital2Analogue!( similar( DigitalValue, Float64 ), Variables, DigitalValue )
+end
+
+"""
+    Digital2Analogue!( BIN::Matrix{ Float64 }, Variables::Dict, DigitalValue::Matrix{ UInt16 } ) → BIN
+        Same conversion as `Digital2Analogue`, written into `BIN` ( e.g. an arena buffer ).
+"""
+function Digital2Analogue!( BIN::Matrix{ Float64 }, Variables::Dict, DigitalValue::Matrix{ UInt16 } )
     # Retrieve conversion parameters from the Variables dictionary
     SignalInversion = Variables[ "SignalInversion" ];
     MinVolt = Variables[ "MinVolt" ];
@@ -890,11 +1330,21 @@ function Digital2Analogue( Variables::Dict, DigitalValue::Matrix{ UInt16 } )
     MVOffset = SignalInversion * MinVolt;
     ADCCountsToMV = ( SignalInversion * ( MaxVolt - MinVolt ) ) / ( 2 ^ BitDepth );
     # Convert the digital values to analog voltage values using the specified formula
-    BIN = @. MVOffset + ( DigitalValue * ADCCountsToMV );
-    # Return the converted matrix of voltage values
+    @. BIN = MVOffset + ( DigitalValue * ADCCountsToMV );
     return BIN
 end
 
+"""
+    ArenaMatrix( A::Vector{ Float64 }, nChs::Int, nfrs::Int ) → BIN::Matrix{ Float64 }
+        nChs × nfrs matrix over the first elements of an arena buffer owned by the GUI
+        ( `SegmentArena`, bound with `jl_ptr_to_array_1d` ). Nothing is allocated or
+        copied; the matrix is only valid while `A` stays bound.
+"""
+function ArenaMatrix( A::Vector{ Float64 }, nChs::Int, nfrs::Int )
+    length( A ) >= nChs * nfrs || throw( ArgumentError( "The arena buffer is smaller than the segment." ) );
+    return unsafe_wrap( Array, pointer( A ), ( nChs, nfrs ) )
+end
+
 """
     SupInfThr( Data::Array, Thr::Real ) → Cols::Vector, Rows::Vector
         Identifies the columns and rows of values in the array that are above a specified
@@ -921,20 +1371,17 @@ end
         external packages.
 """
 function SupInfThr( Data::Array, Thr::Real )
-    # Find indices of elements in the array where the absolute value is greater than or equal
-    # to the threshold
-    SIT = findall( abs.( Data ) .>= Thr );
-    # Extract column and row indices from the positions found
-    AllCols = getindex.( SIT, [ 1 ] );
-    AllRows = getindex.( SIT, [ 2 ] );
-    # Initialize vectors to store unique columns and corresponding rows
-    Rows = [ ];
-    Cols = [ ];
-    # Iterate through unique column indices and organize the rows for each column
-    for col in sort( unique( AllCols ) )
-        push!( Rows, AllRows[ AllCols .== col ] );
-        push!( Cols, col );
+    nChs = size( Data, 1 );
+    # Frames at or above the threshold ( in absolute value ) of every channel
+    Frames = Vector{ Vector{ Int } }( undef, nChs );
+    ForChannels( nChs ) do chs
+        for ch in chs
+            Frames[ ch ] = findall( x -> abs( x ) >= Thr, @view( Data[ ch, : ] ) );
+        end
     end
+    # Keep only the channels that crossed it, in channel order
+    Cols = findall( !isempty, Frames );
+    Rows = Frames[ Cols ];
     return Cols, Rows
 end
 
@@ -967,12 +1414,20 @@ function UniqueCount( Data::Array )
     # Initialize an array to hold the count of unique values for each row
     Count = Array{ Int64 }( undef, N );
     # For each row, compute the number of unique values (after rounding to 2 decimal places)
-    [ Count[ n ] = length( unique( round.( Data[ n, : ], digits = 2 ) ) ) for n in 1:N ];
+    # Sorting a reused row buffer counts them without building a set per channel
+    ForChannels( N ) do chs
+        row = Vector{ Float64 }( undef, size( Data, 2 ) );
+        for n in chs
+            row .= round.( @view( Data[ n, : ] ), digits = 2 );
+            sort!( row );
+            Count[ n ] = isempty( row ) ? 0 : 1 + count( i -> !isequal( row[ i ], row[ i - 1 ] ), 2:length( row ) );
+        end
+    end
     return Count
 end
 
 """
-    STDΔV( Variables::Dict, BIN::AbstractMatrix{ T }, ΔT::Real = 250 ) ⤵
+    STDΔV( Variables::Dict, BIN::AbstractMatrix{ T }, ΔT::Real = 250; window::Int = 0 ) ⤵
         → STD::Vector{ Float64 }
         Calculates the standard deviation of voltage shifts within a dataset, with ΔT
         specified in milliseconds.
@@ -992,6 +1447,8 @@ end
         - `ΔT`: The time shift in milliseconds. This parameter determines how much the
         dataset is shifted when calculating deviations. The default value is 250
         milliseconds.
+        - `window`: When > 0, `BIN` holds runs of `window` frames side by side
+        ( `PreviewSegment` ) and only the shifts inside each run are used, none wraps.
 
         **Outputs**
         - `STD`: A vector of type `Float64` containing the standard deviations of voltage
@@ -1004,22 +1461,56 @@ end
         - **Native Modules**: `StatsBase` – Provides statistical functions including `std`
         for calculating standard deviations.
 """
-function STDΔV( Variables::Dict, BIN::AbstractMatrix{ T }, ΔT::Real = 250 ) where T
-    # Convert the BIN array to Float64 for precise calculations if needed
-    BIN = convert( Matrix{ Float64 }, BIN );
+function STDΔV( Variables::Dict, BIN::AbstractMatrix{ T }, ΔT::Real = 250; window::Int = 0 ) where T
+    nChs, nFrs = size( BIN );
     # Convert ΔT from milliseconds to frames using the ms2frs function
     ΔT = ms2frs( ΔT, Variables );
     # Check if ΔT is within valid range
-    if ΔT <= 0 || ΔT >= size( BIN, 2 )
+    if ΔT <= 0 || ΔT >= ( window > 0 ? window : nFrs )
         throw( ArgumentError(
             "ΔT must be within the range of the dataset's time dimension." ) );
     end
-    # Compute the standard deviation of voltage shifts
-    shifted_BIN = circshift( BIN, ( 0, ΔT ) );
-    voltage_shifts = shifted_BIN .- BIN;
-    std_dev = std( voltage_shifts, dims = 2 );
-    # Extract the result as a vector
-    STD = std_dev[ : ];
+    # Runs of `window` frames side by side ( PreviewSegment ): only the shifts inside a run.
+    # Unlike the circular shifts of the whole segment these do not sum to zero, so their mean
+    # is removed ( a second pass ) for the same standard deviation
+    if window > 0
+        Runs = [ ( a + ΔT ):min( a + window - 1, nFrs ) for a in 1:window:nFrs ];
+        nd = sum( length, Runs );
+        STD = zeros( nChs );
+        ForChannels( nChs ) do chs
+            M = zeros( length( chs ) );
+            for R in Runs, t in R
+                @inbounds @simd for i in eachindex( chs )
+                    M[ i ] += Float64( BIN[ chs[ i ], t - ΔT ] ) - Float64( BIN[ chs[ i ], t ] );
+                end
+            end
+            M ./= nd;
+            SS = zeros( length( chs ) );
+            for R in Runs, t in R
+                @inbounds @simd for i in eachindex( chs )
+                    d = Float64( BIN[ chs[ i ], t - ΔT ] ) - Float64( BIN[ chs[ i ], t ] ) - M[ i ];
+                    SS[ i ] += d * d;
+                end
+            end
+            STD[ chs ] .= sqrt.( SS ./ max( nd - 1, 1 ) );
+        end
+        return STD
+    end
+    # Standard deviation of BIN[ :, t - ΔT ] - BIN[ :, t ] ( circular, as circshift ). The
+    # shifts of a channel sum to zero, so one pass over the frames is enough and no
+    # shifted copy of the segment is built
+    STD = zeros( nChs );
+    ForChannels( nChs ) do chs
+        SS = zeros( length( chs ) );
+        for t in 1:nFrs
+            s = mod1( t - ΔT, nFrs );
+            @inbounds @simd for i in eachindex( chs )
+                d = Float64( BIN[ chs[ i ], s ] ) - Float64( BIN[ chs[ i ], t ] );
+                SS[ i ] += d * d;
+            end
+        end
+        STD[ chs ] .= sqrt.( SS ./ ( nFrs - 1 ) );
+    end
     return STD
 end
 
@@ -1054,6 +1545,178 @@ function ms2frs( time::Real, Variables::Dict )
     SamplingRate = Variables[ "SamplingRate" ];
     return ceil( Int, ( time * SamplingRate ) / 1000 );
 end
+# ----------------------------------------------------------------------------------------- #
+#                                   Trace pyramid
+# ----------------------------------------------------------------------------------------- #
+# One block of the pyramid: extremes in ADC codes, mean and RMS ( around the mean ) in codes.
+struct PyramidBlock
+    mn::UInt16
+    mx::UInt16
+    μ::Float32
+    rms::Float32
+end
+
+"""
+    TracePyramid
+        Per-channel min/max/RMS decimation pyramid of the raw recording, written while STEP00
+        runs. Level 1 summarizes blocks of `F0` frames, every next level merges `R` blocks of
+        the previous one. Each level is stored channel-major, so the trace viewer reads one
+        channel at any zoom as one contiguous run of `PyramidBlock`s.
+        Blocks that straddle two segments are completed with the `carry` of each level.
+"""
+mutable struct TracePyramid
+    io::IOStream
+    nChs::Int
+    frames::Int
+    F0::Int
+    R::Int
+    nBlocks::Vector{ Int }
+    offsets::Vector{ Int }
+    written::Vector{ Int }
+    carry::Vector{ Any }
+end
+
+"""
+    OpenPyramid( filename::String, Variables::Dict, F0::Int = 64, R::Int = 4 ) → P::TracePyramid
+        Creates the pyramid file with its header: magic "EVALPYR1", nChs, NRecFrames, F0, R,
+        nLevels, SamplingRate, MVOffset, ADCCountsToMV and the ( blocks, offset ) of each
+        level. Levels are added while they still have more than 256 blocks per channel.
+"""
+function OpenPyramid( filename::String, Variables::Dict, F0::Int = 64, R::Int = 4 )
+    nChs = Variables[ "nChs" ];
+    NRecFrames = Int( Variables[ "NRecFrames" ] );
+    # Blocks per channel of each level
+    nBlocks = [ cld( NRecFrames, F0 ) ];
+    while nBlocks[ end ] > 256 * R
+        push!( nBlocks, cld( nBlocks[ end ], R ) );
+    end
+    nLevels = length( nBlocks );
+    # Conversion of the codes to μV, as in Digital2Analogue
+    SignalInversion = Variables[ "SignalInversion" ];
+    MVOffset = SignalInversion * Variables[ "MinVolt" ];
+    ADCCountsToMV = ( SignalInversion * ( Variables[ "MaxVolt" ] - Variables[ "MinVolt" ] ) ) /
+        ( 2 ^ Variables[ "BitDepth" ] );
+    headersize = 8 + 5 * 8 + 3 * 8 + nLevels * 16;
+    offsets = cumsum( vcat( headersize, nChs .* nBlocks[ 1:end - 1 ] .* sizeof( PyramidBlock ) ) );
+    io = open( filename, "w" );
+    write( io, b"EVALPYR1" );
+    write( io, Int64.( [ nChs, NRecFrames, F0, R, nLevels ] ) );
+    write( io, Float64.( [ Variables[ "SamplingRate" ], MVOffset, ADCCountsToMV ] ) );
+    for L in 1:nLevels
+        write( io, Int64( nBlocks[ L ] ), Int64( offsets[ L ] ) );
+    end
+    carry = Any[ zeros( UInt16, nChs, 0 ) ];
+    append!( carry, [ Vector{ PyramidBlock }[ PyramidBlock[ ] for _ in 1:nChs ] for _ in 2:nLevels ] );
+    return TracePyramid( io, nChs, NRecFrames, F0, R, nBlocks, offsets, zeros( Int, nLevels ), carry )
+end
+
+"""
+    AddPyramid!( P::TracePyramid, BIN::Matrix{ UInt16 } ) → P::TracePyramid
+        Appends the next segment ( raw ADC codes, nChs x nfrs ) to every level of the pyramid.
+"""
+function AddPyramid!( P::TracePyramid, BIN::Matrix{ UInt16 } )
+    # Only the frames that complete the block carried from the previous segment are copied,
+    # the rest of the segment is summarized in place
+    c = size( P.carry[ 1 ], 2 );
+    h = min( mod( P.F0 - c, P.F0 ), size( BIN, 2 ) );
+    Head = hcat( P.carry[ 1 ], view( BIN, :, 1:h ) );
+    if 0 < size( Head, 2 ) < P.F0
+        P.carry[ 1 ] = Head;
+        return P
+    end
+    nb = ( size( BIN, 2 ) - h ) ÷ P.F0;
+    Blocks = [ vcat( SampleBlocks( view( Head, ch, : ), P.F0 ),
+        SampleBlocks( view( BIN, ch, ( h + 1 ):( h + nb * P.F0 ) ), P.F0 ) ) for ch in 1:P.nChs ];
+    P.carry[ 1 ] = BIN[ :, ( h + nb * P.F0 + 1 ):end ];
+    PyramidLevel!( P, 1, Blocks );
+    return P
+end
+
+"""
+    ClosePyramid!( P::TracePyramid ) → Nothing
+        Writes the partial blocks left at the end of the recording and closes the file.
+"""
+function ClosePyramid!( P::TracePyramid )
+    if size( P.carry[ 1 ], 2 ) > 0
+        X = P.carry[ 1 ];
+        P.carry[ 1 ] = X[ :, 1:0 ];
+        PyramidLevel!( P, 1, [ SampleBlocks( view( X, ch, : ), size( X, 2 ) ) for ch in 1:P.nChs ], true );
+    else
+        PyramidLevel!( P, 1, [ PyramidBlock[ ] for _ in 1:P.nChs ], true );
+    end
+    close( P.io );
+    return nothing
+end
+
+# Blocks of F samples of one channel
+function SampleBlocks( x::AbstractVector{ UInt16 }, F::Int )
+    B = Vector{ PyramidBlock }( undef, length( x ) ÷ F );
+    for b in eachindex( B )
+        w = view( x, ( ( b - 1 ) * F + 1 ):( b * F ) );
+        μ = mean( w );
+        B[ b ] = PyramidBlock( minimum( w ), maximum( w ), μ, sqrt( mean( v -> ( v - μ ) ^ 2, w ) ) );
+    end
+    return B
+end
+
+# Merges blocks of `n` frames each: the variance of the union is the weighted mean variance
+# plus the weighted variance of the means ( only the last block of the recording is shorter )
+function MergeBlocks( w::AbstractVector{ PyramidBlock }, n::AbstractVector{ Int } )
+    N = sum( n );
+    μ = sum( n[ i ] * w[ i ].μ for i in eachindex( w ) ) / N;
+    v = sum( n[ i ] * ( w[ i ].rms ^ 2 + ( w[ i ].μ - μ ) ^ 2 ) for i in eachindex( w ) ) / N;
+    return PyramidBlock( minimum( b -> b.mn, w ), maximum( b -> b.mx, w ), μ, sqrt( v ) )
+end
+
+# Writes the new blocks of level L and feeds them to level L + 1
+function PyramidLevel!( P::TracePyramid, L::Int, Blocks::Vector, flush::Bool = false )
+    nb = length( Blocks[ 1 ] );
+    nb = min( nb, P.nBlocks[ L ] - P.written[ L ] );
+    if nb > 0
+        for ch in 1:P.nChs
+            seek( P.io, P.offsets[ L ] + ( ( ch - 1 ) * P.nBlocks[ L ] + P.written[ L ] ) * sizeof( PyramidBlock ) );
+            write( P.io, Blocks[ ch ][ 1:nb ] );
+        end
+        P.written[ L ] += nb;
+    end
+    L == length( P.nBlocks ) && return nothing
+    Next = Vector{ Vector{ PyramidBlock } }( undef, P.nChs );
+    nominal = P.F0 * P.R ^ ( L - 1 ); # Frames of a block of level L
+    for ch in 1:P.nChs
+        W = vcat( P.carry[ L + 1 ][ ch ], Blocks[ ch ][ 1:nb ] );
+        n = fill( nominal, length( W ) );
+        if flush && !isempty( W )
+            n[ end ] = P.frames - ( P.nBlocks[ L ] - 1 ) * nominal; # The last block of the recording
+        end
+        k = length( W ) ÷ P.R;
+        Next[ ch ] = [ MergeBlocks( view( W, ( ( j - 1 ) * P.R + 1 ):( j * P.R ) ), view( n, ( ( j - 1 ) * P.R + 1 ):( j * P.R ) ) ) for j in 1:k ];
+        rest = W[ ( k * P.R + 1 ):end ];
+        if flush && !isempty( rest )
+            push!( Next[ ch ], MergeBlocks( rest, n[ ( k * P.R + 1 ):end ] ) );
+            rest = PyramidBlock[ ];
+        end
+        P.carry[ L + 1 ][ ch ] = rest;
+    end
+    PyramidLevel!( P, L + 1, Next, flush );
+end
+
+"""
+    TraceSamples( Variables::Dict, ch::Int, fr0::Int, frN::Int ) → V::Vector{ Float32 }
+        Voltage ( μV ) of channel `ch` between frames `fr0` and `frN`, read from the BRW file as
+        a single-channel hyperslab ( strided for the flat layout ).
+"""
+function TraceSamples( Variables::Dict, ch::Int, fr0::Int, frN::Int )
+    nChs = Variables[ "nChs" ];
+    RAW = OpenRaw( Variables; sequential = false );
+    if ndims( RAW ) == 2
+        X = vec( RAW[ ch:ch, fr0:frN ] );
+    else
+        X = RAW[ ( ( fr0 - 1 ) * nChs + ch ):nChs:( ( frN - 1 ) * nChs + ch ) ];
+    end
+    CloseRaw( RAW );
+    return vec( Float32.( Digital2Analogue( Variables, reshape( UInt16.( X ), 1, : ) ) ) )
+end
+
 # ----------------------------------------------------------------------------------------- #
 #                                       Module STEP01_v1
 # ----------------------------------------------------------------------------------------- #
@@ -1077,6 +1740,35 @@ function LoadDict( filename::String )
     return D
 end
 
+"""
+    LoadSegment( Variables::Dict, BINNAME::String, n::Int, N::Int, Streaming::Bool ) ⤵
+        → BIN::Matrix{ Float64 }
+        Voltage of the n-th segment. Reads the STEP00 dump `BINNAME` when it exists
+        ( `Streaming = false` ), otherwise streams the segment again from the raw BRW file,
+        which avoids writing and re-reading intermediate segments.
+        # Custom
+        using OneSegment, Digital2Analogue, LoadDict
+"""
+function LoadSegment( Variables::Dict, BINNAME::String, n::Int, N::Int, Streaming::Bool )
+    fr0, frN = SegmentFrames( Variables, n, N );
+    BIN = Matrix{ Float64 }( undef, Variables[ "nChs" ], frN - fr0 + 1 );
+    return LoadSegment!( BIN, Variables, BINNAME, n, N, Streaming )
+end
+
+"""
+    LoadSegment!( BIN::Matrix{ Float64 }, Variables::Dict, BINNAME::String, n::Int, N::Int, Streaming::Bool ) → BIN
+        `LoadSegment` into a preallocated nChs × nfrs matrix ( e.g. an arena buffer ).
+"""
+function LoadSegment!( BIN::Matrix{ Float64 }, Variables::Dict, BINNAME::String, n::Int, N::Int, Streaming::Bool )
+    if !Streaming
+        return copyto!( BIN, LoadDict( BINNAME ) )
+    end
+    RAW = OpenRaw( Variables );
+    GC.@preserve RAW Digital2Analogue!( BIN, Variables, OneSegment( RAW, Variables, n, N ) );
+    CloseRaw( RAW );
+    return BIN
+end
+
 """
     BarPlot( W::VecOrMat, fc::Symbol = :royalblue3, t::String = "", xl::String = "", yl::String = "" ) → Plot
         # Native
@@ -1106,16 +1798,7 @@ end
         Find values above Thr and below -Thr. Organized on Columns and Rows
 """
 function SupThr( Data::Array, Thr::Real )
- ST = findall( abs.( Data ) .>= Thr );
-    AllCols = getindex.( ST, [ 1 ] );
-    AllRows = getindex.( ST, [ 2 ] );
-    Rows = [ ];
-    Cols = [ ];
-    for col in sort( unique( AllCols ) )
-        push!( Rows, AllRows[ AllCols .== col ] );
-        push!( Cols, col )
-    end
-    return Cols, Rows
+    return SupInfThr( Data, Thr )
 end
 
 """
@@ -1211,6 +1894,29 @@ function ReconstructChannels( data::Array, lim = 10 )
     return fictional_channel
 end
 
+"""
+    ReconstructEmpties!( BIN::Matrix, Empties::Vector, minchan::Int, maxrad::Int, maxIt::Int ) → BIN
+        Replaces every empty channel with a fictional one built from `minchan` random
+        neighbours ( `ReconstructChannels` ), widening the radius up to `maxrad`. In the order
+        of `Empties`, one after another: a neighbour may be another empty channel, already
+        reconstructed or not yet, as it always has been.
+        # Native
+        using StatsBase
+"""
+function ReconstructEmpties!( BIN::Matrix, Empties::Vector, minchan::Int, maxrad::Int, maxIt::Int )
+    for emptie in Empties
+        rad = 1;
+        _, neigh = Neighbours( emptie, rad );
+        while length( neigh ) <= minchan && rad <= maxrad
+            rad = rad + 1;
+            _, neigh = Neighbours( emptie, rad );
+        end
+        neighs = sort( sample( neigh, minchan, replace = false ) );
+        BIN[ emptie, : ] = ReconstructChannels( BIN[ neighs, : ], maxIt );
+    end
+    return BIN
+end
+
 """
     PatchEmpties( aux::Vector, Empties::Vector = [ ] ) → aux::Vector
         Replaces the aux vector values in the Empties vector positions with random non-Empties aux values.
@@ -1220,7 +1926,7 @@ end
 """
 function PatchEmpties( aux::Vector, Empties::Vector = [ ] )
     nChs = length( aux );
-    NotEmpties = setdiff( 1:nChs, Empties );
+    NotEmpties = filter( c -> isfinite( aux[ c ] ), setdiff( 1:nChs, Empties ) ); # Not outside a ROI
     nv = sample( NotEmpties, length( Empties ) );
     aux[ Empties ] = aux[ nv ];
     return aux
@@ -1239,7 +1945,8 @@ function Zplot( W::VecOrMat, cm_::Symbol = :vik, forGUI::Bool = true, t::String
     Z = reverse( reshape( W, nc, nc )', dims = 1 );
 
     if c == 0
-        c = median( W ) + ( 2 * std( W ) );
+        F = filter( isfinite, W ); # Channels outside a ROI are NaN and left blank
+        c = median( F ) + ( 2 * std( F ) );
     end
     
     Plots.gr( );
@@ -1280,11 +1987,43 @@ end
 # ----------------------------------------------------------------------------------------- #
 #                                   Jorgio functions
 # ----------------------------------------------------------------------------------------- #
-function Channel_Spectrogram( BINRAW::Matrix{Float64}, channel::Int64, n1::Int64, n_overlap1::Int64 )
-    fs = 17855.55;
-    signal = Float32.( BINRAW[channel, :] );
-    spectro1 = mt_spectrogram( signal, n1, n_overlap1, fs=fs );
-    time = ( 0:length( signal ) - 1) / fs;
+# Sampling rate the spectrograms have always been computed with
+const SpectrogramRate = 17855.55;
+
+Channel_Spectrogram( BINRAW::Matrix{Float64}, channel::Int64, n1::Int64, n_overlap1::Int64 ) = Channel_Spectrogram( BINRAW[ channel, : ], channel, n1, n_overlap1 );
+
+function Channel_Spectrogram( signal::AbstractVector, channel::Int64, n1::Int64, n_overlap1::Int64 )
+    signal = Float32.( signal );
+    time = ( 0:length( signal ) - 1) / SpectrogramRate;
+    spectime, delta_norm, theta_norm, alpha_norm = SpectrogramBands( signal, n1, n_overlap1 );
+
+    p = plot(
+        plot(time, signal,
+            xlabel="Time (s)", ylabel="Amplitude (μV)", legend=false, label=false),
+        plot(spectime, delta_norm,
+            xlabel="Time (s)", ylabel="Normalized Power", legend=false, label=false),
+        plot(spectime, theta_norm,
+            xlabel="Time (s)", ylabel="Normalized Power", legend=false, label=false),
+        plot(spectime, alpha_norm,
+            xlabel="Time (s)", ylabel="Normalized Power", legend=false, label=false),
+        layout = @layout([a; b; c; d]), 
+        title=["Original signal from channel $channel" "Delta Band (0-5 Hz)" "Theta Band (4-9 Hz)" "Alpha Band (8-12 Hz)"],
+        wsize = (800, 800)
+    );
+
+    return p
+end
+
+"""
+    SpectrogramBands( signal::AbstractVector, n1::Int, n_overlap1::Int ) → time, delta, theta, alpha
+        The series of `Channel_Spectrogram` without the figure: the multitaper spectrogram of
+        the signal ( window `n1`, overlap `n_overlap1` ) and, for each band, the mean over its
+        frequencies of the z-scored power, scaled so its maximum is 1.
+        # Native
+        using DSP, StatsBase
+"""
+function SpectrogramBands( signal::AbstractVector, n1::Int, n_overlap1::Int )
+    spectro1 = mt_spectrogram( Float32.( signal ), n1, n_overlap1, fs = SpectrogramRate );
 
     bands = Dict(
         :delta => (0, 5),
@@ -1312,34 +2051,906 @@ function Channel_Spectrogram( BINRAW::Matrix{Float64}, channel::Int64, n1::Int64
     theta_norm = power_data_theta_norm_avg ./ maximum(power_data_theta_norm_avg)
     alpha_norm = power_data_alpha_norm_avg ./ maximum(power_data_alpha_norm_avg)
 
-    p = plot(
-        plot(time, signal,
-            xlabel="Time (s)", ylabel="Amplitude (μV)", legend=false, label=false),
-        plot(spectro1.time, delta_norm,
-            xlabel="Time (s)", ylabel="Normalized Power", legend=false, label=false),
-        plot(spectro1.time, theta_norm,
-            xlabel="Time (s)", ylabel="Normalized Power", legend=false, label=false),
-        plot(spectro1.time, alpha_norm,
-            xlabel="Time (s)", ylabel="Normalized Power", legend=false, label=false),
-        layout = @layout([a; b; c; d]), 
-        title=["Original signal from channel $channel" "Delta Band (0-5 Hz)" "Theta Band (4-9 Hz)" "Alpha Band (8-12 Hz)"],
-        wsize = (800, 800)
-    );
+    return spectro1.time, delta_norm, theta_norm, alpha_norm
+end
 
-    return p
+"""
+    SpectrogramSeries( Variables::Dict, BINNAME::String, n::Int, N::Int, Streaming::Bool, channel::Int, n1::Int, n_overlap1::Int, path::String; columns::Int = 800 ) → filename::String
+        Writes what the GUI draws the spectrogram figure of a channel from ( SpectrogramFigure )
+        and returns its name, `BIN_<n>_Channel_<ch>` ( without extension ).
+
+        **Purpose**
+        The STFT is the only part of a spectrogram that needs Julia; the figure is drawn
+        natively, so the clicks on the maps and the hover prefetch of the GUI never wait for GR.
+        Streamed segments read just the hyperslab of the channel ( `TraceSamples` ) instead of
+        the whole segment. No global is touched, it may run while a batch segment is halfway
+        through.
+
+        **Inputs**
+        - `Variables`: Metadata of the BRW.
+        - `BINNAME`: STEP00 dump of the segment, used when `Streaming` is false.
+        - `n`, `N`: Segment and number of segments.
+        - `channel`: Channel of the spectrogram.
+        - `n1`, `n_overlap1`: Window and overlap of the spectrogram.
+        - `path`: Folder of the files ( PATHSPECTROGRAMS ).
+        - `columns`: Bins of the min/max envelope of the signal, one per pixel of the figure.
+
+        **Outputs**
+        - `<filename>.spg`, little-endian: "EVALSPG1", Int64 channel, columns, times, Float64
+        duration ( s ), then Float64 arrays: the minimum and the maximum of the signal in each
+        column, the times of the spectrogram and the delta, theta and alpha series
+        ( `SpectrogramBands` ).
+
+        **Requirements**
+        - **DSP**.
+"""
+function SpectrogramSeries( Variables::Dict, BINNAME::String, n::Int, N::Int, Streaming::Bool, channel::Int, n1::Int, n_overlap1::Int, path::String; columns::Int = 800 )
+    fr0, frN = SegmentFrames( Variables, n, N );
+    signal = Float32.( Streaming ? TraceSamples( Variables, channel, fr0, frN ) : LoadDict( BINNAME )[ channel, : ] );
+    isempty( signal ) && return ""
+    time, delta, theta, alpha = SpectrogramBands( signal, n1, n_overlap1 );
+    L = length( signal );
+    columns = clamp( L, 1, columns );
+    edges = round.( Int, range( 0, L, length = columns + 1 ) );
+    bins = [ view( signal, ( edges[ c ] + 1 ):edges[ c + 1 ] ) for c in 1:columns ];
+    filename = joinpath( path, "BIN_$( lpad( n, length( string( N ) ), "0" ) )_Channel_$channel" );
+    # Written under another name first, a file the GUI finds is always complete
+    open( filename * ".spg.tmp", "w" ) do io
+        write( io, "EVALSPG1" );
+        write( io, Int64( channel ), Int64( columns ), Int64( length( time ) ), Float64( L / SpectrogramRate ) );
+        write( io, Float64.( minimum.( bins ) ), Float64.( maximum.( bins ) ) );
+        write( io, Float64.( time ), Float64.( delta ), Float64.( theta ), Float64.( alpha ) );
+    end
+    mv( filename * ".spg.tmp", filename * ".spg"; force = true );
+    return filename
 end
 
 # ----------------------------------------------------------------------------------------- #
-#                              Julia auxiliar functions for Qt
+#                                     Results store
 # ----------------------------------------------------------------------------------------- #
-"""
-    ChunkSizeSpace( Variables::Dict, limupper::Real ) -> σ::Int
-        Determina el numero de segmentos en los que el dataset se debe recortar considerando el tamano en espacio de disco que ocupara cada uno. limupper es el tamano maximo establecido por el usuario en GB.
-"""
-function optimal_file_size(Variables::Dict, limupper::Real)
-    NRecFrames = Variables["NRecFrames"]
-    σ = max(1, Int(floor(Variables["dsetsize"] / limupper)))
-    finalsize = Variables["dsetsize"] / σ
+# Info/STEPxx.res: typed columns instead of Array{ Any } dictionaries, memory-mappable from C++
+# ( ResultsStore ). Little-endian, all sections 8-byte aligned:
+#   header    "EVALRES1", Int64 nChs, N, nMatrices, nTables, nLists, colormap ( 16 bytes )
+#   directory name ( 32 bytes ), Int64 offset, Int64 count per entry: matrices, tables, lists
+#   matrices  Float64 nChs × N, one contiguous column per segment, NaN if not evaluated
+#   tables    count × ( segment, channel, first, last ) Int32 rows: frame intervals
+#   lists     count Int32
+const ResultsMagic = "EVALRES1";
+
+"""
+    SaveResults( filename::String, nChs::Int, N::Int; colormap::Symbol = :vik, matrices = [ ], tables = [ ], lists = [ ] )
+        Writes a results store.
+        - `matrices`: `name => Vector` of N per-segment vectors ( `[ ]` for missing segments ).
+        - `tables`: `name => Vector` of N `Dict( "Chs" => channels, "Frs" => frame groups )`,
+        as `Sats`/`Repaired`; every group is stored as its ( first, last ) interval.
+        - `lists`: `name => Vector{ Int }`.
+"""
+function SaveResults( filename::String, nChs::Int, N::Int; colormap::Symbol = :vik, matrices = [ ], tables = [ ], lists = [ ] )
+    Name( x, n ) = rpad( first( string( x ), n - 1 ), n, '\0' );
+    Rows = [ ];
+    for ( _, T ) in tables
+        R = Int32[ ];
+        for n in 1:N
+            isassigned( T, n ) && T[ n ] isa Dict || continue
+            for ( ch, fr ) in zip( T[ n ][ "Chs" ], T[ n ][ "Frs" ] )
+                append!( R, Int32[ n, ch, minimum( fr ), maximum( fr ) ] );
+            end
+        end
+        push!( Rows, R );
+    end
+    nEntries = length( matrices ) + length( tables ) + length( lists );
+    offset = 64 + 48 * nEntries;
+    Dir = [ ];
+    for ( name, _ ) in matrices
+        push!( Dir, ( name, offset, nChs * N ) ); offset += 8 * nChs * N;
+    end
+    for ( ( name, _ ), R ) in zip( tables, Rows )
+        push!( Dir, ( name, offset, length( R ) ÷ 4 ) ); offset += 4 * length( R );
+    end
+    for ( name, L ) in lists
+        push!( Dir, ( name, offset, length( L ) ) ); offset += 8 * cld( length( L ), 2 );
+    end
+    open( filename * ".tmp", "w" ) do io
+        write( io, ResultsMagic );
+        write( io, Int64[ nChs, N, length( matrices ), length( tables ), length( lists ) ] );
+        write( io, Name( colormap, 16 ) );
+        for ( name, off, count ) in Dir
+            write( io, Name( name, 32 ) ); write( io, Int64[ off, count ] );
+        end
+        for ( _, M ) in matrices
+            for n in 1:N
+                col = isassigned( M, n ) ? M[ n ] : [ ];
+                write( io, length( col ) == nChs ? Float64.( vec( col ) ) : fill( NaN, nChs ) );
+            end
+        end
+        foreach( R -> write( io, R ), Rows );
+        for ( _, L ) in lists
+            write( io, Int32.( L ) ); isodd( length( L ) ) && write( io, Int32( 0 ) );
+        end
+    end
+    mv( filename * ".tmp", filename; force = true );
+    return filename
+end
+
+"""
+    StepResults( PATHINFO::String, step::String ) → D::Dict
+        Results of "STEP00" or "STEP01" with typed values: matrices as nChs × N
+        `Matrix{ Float64 }` memory-mapped from the store ( only the pages of the columns that
+        are used are read ), tables as `Matrix{ Int32 }` rows ( segment, channel, first, last )
+        and lists as `Vector{ Int }`. Projects evaluated before the store existed are read from
+        their .jld2 and converted to the same types.
+        # Native
+        using JLD2, Mmap
+"""
+function StepResults( PATHINFO::String, step::String )
+    FILERES = joinpath( PATHINFO, string( step, ".res" ) );
+    D = Dict{ String, Any }( );
+    if !isfile( FILERES )
+        Old = LoadDict( joinpath( PATHINFO, string( step, ".jld2" ) ) );
+        for ( k, v ) in Old
+            if k == "Empties"
+                D[ k ] = Int.( v );
+            elseif k in ( "Sats", "Repaired" )
+                D[ k ] = permutedims( reshape( Int32[ x for n in eachindex( v ) if v[ n ] isa Dict
+                    for ( ch, fr ) in zip( v[ n ][ "Chs" ], v[ n ][ "Frs" ] )
+                    for x in ( n, ch, minimum( fr ), maximum( fr ) ) ], 4, : ) );
+            else
+                nChs = maximum( length.( v ) );
+                D[ k ] = hcat( [ length( c ) == nChs ? Float64.( vec( c ) ) : fill( NaN, nChs ) for c in v ]... );
+            end
+        end
+        return D
+    end
+    io = open( FILERES, "r" );
+    String( read( io, 8 ) ) == ResultsMagic || error( "Not a results store: $FILERES" );
+    nChs, N, nM, nT, nL = read!( io, Vector{ Int64 }( undef, 5 ) );
+    D[ "colormap" ] = Symbol( rstrip( String( read( io, 16 ) ), '\0' ) );
+    for e in 1:( nM + nT + nL )
+        name = rstrip( String( read( io, 32 ) ), '\0' );
+        off, count = read!( io, Vector{ Int64 }( undef, 2 ) );
+        if e <= nM
+            D[ name ] = Mmap.mmap( io, Matrix{ Float64 }, ( nChs, N ), off );
+        elseif e <= nM + nT
+            D[ name ] = permutedims( Mmap.mmap( io, Matrix{ Int32 }, ( 4, count ), off ) );
+        else
+            D[ name ] = Int.( Mmap.mmap( io, Vector{ Int32 }, count, off ) );
+        end
+    end
+    close( io );
+    return D
+end
+
+# Version of the algorithms behind the cached results: raise it whenever a kernel, a map or a
+# spectrogram changes, so the artifact cache stops handing out results of the old code
+const ArtifactVersion = 2;
+
+"""
+    ArtifactParameters( P::AbstractDict ) → key::String
+    ArtifactParameters( ; kwargs... ) → key::String
+        Canonical text of the parameters a result depends on, the part of the keys of the
+        artifact cache of the GUI ( ArtifactCache ) that is not the recording, the segment or
+        the channel, with the `ArtifactVersion` of the code. Sorted by name, so the order they
+        are given in does not matter.
+"""
+function ArtifactParameters( P::AbstractDict )
+    P = merge( P, Dict( "Version" => ArtifactVersion ) );
+    return join( [ string( k, "=", repr( P[ k ] ) ) for k in sort( collect( keys( P ) ), by = string ) ], ";" )
+end
+
+ArtifactParameters( ; kwargs... ) = ArtifactParameters( Dict( string( k ) => v for ( k, v ) in kwargs ) );
+
+# ----------------------------------------------------------------------------------------- #
+#                                    Segment sketches
+# ----------------------------------------------------------------------------------------- #
+# Info/Sketch.bin: per-channel statistics of base blocks ( a fraction of a segment ) in a form
+# that merges, so the maps of any multiple of the base block need no second pass over the BRW
+const SketchMagic = "EVALSKT1";
+
+"""
+    SegmentSketch
+        Open sketch file of a STEP00 run. Every base block is written as: Int64 first frame,
+        last frame, n ( differences counted ) and number of bitset words, then per channel
+        the Float64 mean and M2 of the voltage shifts, the Int32 first word and word count of
+        its ADC code bitset, and the packed words. `carry` keeps the last ΔT frames of the
+        previous segment, so the shifts run across the segment boundaries; `next` is the frame
+        that follows it, the carry is only used by a segment starting there.
+"""
+mutable struct SegmentSketch
+    io::IOStream
+    nChs::Int
+    W::Int
+    ΔT::Int
+    split::Int
+    carry::Matrix{ Float64 }
+    next::Int
+end
+
+"""
+    OpenSketch( filename::String, Variables::Dict, Δt::Real; split::Int = 4, codes::Bool = true ) → S::SegmentSketch
+        Creates the sketch file with its header: magic "EVALSKT1", nChs, bitset words per
+        channel, ΔT in frames and base blocks per segment, then the SamplingRate.
+
+        **Purpose**
+        The segment length chosen by `GetChunkSize` fixes the maps of a run. The sketch keeps
+        what the maps need for every base block ( `split` per segment ) in mergeable form:
+        - VSD: count, mean and M2 of BIN[ :, t - ΔT ] - BIN[ :, t ], merged with Chan's formula.
+        - Cardinality: the set of ADC codes of each channel as an exact bitset ( one bit per
+        code, stored between its first and last non-zero word ), merged with OR. Codes are
+        the values before the conversion to μV, so with a filter the set does not describe
+        the filtered signal and is not kept ( `codes = false` ).
+        `RebinSketch` turns any number of consecutive base blocks into one segment.
+
+        **Inputs**
+        - `filename`: Path of the sketch, usually Info/Sketch.bin.
+        - `Variables`: Dictionary with the metadata of the BRW file.
+        - `Δt`: Shift of the VSD in ms, as in `STDΔV`.
+        - `split`: Base blocks per segment.
+        - `codes`: Whether the bitsets of the ADC codes are kept.
+
+        **Requirements**
+        - **Custom Functions**: `ms2frs`
+"""
+function OpenSketch( filename::String, Variables::Dict, Δt::Real; split::Int = 4, codes::Bool = true )
+    nChs = Variables[ "nChs" ];
+    W = codes ? cld( 2 ^ Variables[ "BitDepth" ], 64 ) : 0;
+    ΔT = ms2frs( Δt, Variables );
+    io = open( filename, "w" );
+    write( io, SketchMagic );
+    write( io, Int64[ nChs, W, ΔT, split ] );
+    write( io, Float64( Variables[ "SamplingRate" ] ) );
+    return SegmentSketch( io, nChs, W, ΔT, split, zeros( nChs, 0 ), 0 )
+end
+
+"""
+    AddSketch!( S::SegmentSketch, BINDIG::AbstractMatrix{ UInt16 }, BIN::AbstractMatrix{ Float64 }, fr0::Int ) → S::SegmentSketch
+        Appends the base blocks of the next segment: `BINDIG` in ADC codes for the bitsets and
+        `BIN` in μV ( after the filter, as the VSD ) for the moments. `fr0` is its first frame.
+        The blocks are computed first and written together, so a cancelled segment leaves
+        no partial block behind. After a segment that failed and was skipped the carry is not
+        adjacent, the shifts then start ΔT frames into the segment as in the first one.
+"""
+function AddSketch!( S::SegmentSketch, BINDIG::AbstractMatrix{ UInt16 }, BIN::AbstractMatrix{ Float64 }, fr0::Int )
+    nChs, nfrs = size( BIN );
+    nc = fr0 == S.next ? size( S.carry, 2 ) : 0;
+    # Frame t - ΔT of the shifts, from the previous segment when it falls before this one
+    @inline Prev( c, t ) = t > S.ΔT ? BIN[ c, t - S.ΔT ] : S.carry[ c, nc + t - S.ΔT ];
+    Blocks = [ ];
+    for i in 1:S.split
+        a = 1 + ( ( i - 1 ) * nfrs ) ÷ S.split;
+        b = ( i * nfrs ) ÷ S.split;
+        t0 = max( a, S.ΔT - nc + 1 );
+        n = max( 0, b - t0 + 1 );
+        μ = zeros( nChs );
+        M2 = zeros( nChs );
+        Bits = zeros( UInt64, S.W, nChs );
+        ForChannels( nChs ) do chs
+            # Two passes, mean first, so M2 does not lose the precision of the mean
+            for t in t0:b
+                @inbounds @simd for c in chs
+                    μ[ c ] += Prev( c, t ) - BIN[ c, t ];
+                end
+            end
+            μ[ chs ] ./= max( n, 1 );
+            for t in t0:b
+                @inbounds @simd for c in chs
+                    M2[ c ] += ( Prev( c, t ) - BIN[ c, t ] - μ[ c ] ) ^ 2;
+                end
+            end
+            S.W == 0 && return
+            for t in a:b
+                @inbounds for c in chs
+                    code = BINDIG[ c, t ];
+                    Bits[ ( code >> 6 ) + 1, c ] |= one( UInt64 ) << ( code & 63 );
+                end
+            end
+        end
+        # Only the words between the first and last codes seen
+        lo = zeros( Int32, nChs );
+        nw = zeros( Int32, nChs );
+        Words = UInt64[ ];
+        for c in 1:nChs
+            used = findall( !iszero, @view( Bits[ :, c ] ) );
+            isempty( used ) && continue
+            lo[ c ] = used[ 1 ] - 1;
+            nw[ c ] = used[ end ] - used[ 1 ] + 1;
+            append!( Words, @view( Bits[ used[ 1 ]:used[ end ], c ] ) );
+        end
+        push!( Blocks, ( Int64[ fr0 + a - 1, fr0 + b - 1, n, length( Words ) ], μ, M2, lo, nw, Words ) );
+    end
+    foreach( B -> foreach( x -> write( S.io, x ), B ), Blocks );
+    flush( S.io );
+    S.carry = BIN[ :, max( 1, nfrs - S.ΔT + 1 ):nfrs ];
+    S.next = fr0 + nfrs;
+    return S
+end
+
+"""
+    CloseSketch!( S::SegmentSketch ) → nothing
+"""
+function CloseSketch!( S::SegmentSketch )
+    close( S.io );
+    S.carry = zeros( S.nChs, 0 );
+    return nothing
+end
+
+# Header of a sketch file, leaves io at the first block
+function SketchHeader( io::IO )
+    String( read( io, 8 ) ) == SketchMagic || error( "Not a sketch file" );
+    nChs, W, ΔT, split = read!( io, Vector{ Int64 }( undef, 4 ) );
+    fs = read( io, Float64 );
+    return nChs, W, ΔT, split, fs
+end
+
+# First frame, last frame, n and words of every block, in file order
+function SketchBlocks( io::IO, nChs::Int )
+    Blocks = Vector{ Int64 }[ ];
+    while !eof( io )
+        B = read!( io, Vector{ Int64 }( undef, 4 ) );
+        push!( Blocks, B );
+        skip( io, 16 * nChs + 8 * nChs + 8 * B[ 4 ] );
+    end
+    return Blocks
+end
+
+"""
+    SketchInfo( filename::String ) → nBlocks::Int, seconds::Float64, split::Int, codes::Bool
+        Number of base blocks of a sketch, their mean duration, the blocks per segment of the
+        run that wrote it and whether it kept the ADC codes ( Cardinality ).
+"""
+function SketchInfo( filename::String )
+    io = open( filename, "r" );
+    nChs, W, _, split, fs = SketchHeader( io );
+    Blocks = SketchBlocks( io, nChs );
+    close( io );
+    frames = isempty( Blocks ) ? 0 : Blocks[ end ][ 2 ] - Blocks[ 1 ][ 1 ] + 1;
+    return length( Blocks ), frames / ( fs * max( length( Blocks ), 1 ) ), split, W > 0
+end
+
+"""
+    RebinSketch( filename::String, m::Int ) → Cardinality::Matrix{ Float64 }, VSD::Matrix{ Float64 }, Frames::Vector{ Tuple{ Int, Int } }
+        Maps of segments of `m` base blocks merged from a sketch, without reading the BRW.
+
+        **Purpose**
+        Consecutive groups of `m` blocks become one segment ( a last group shorter than half
+        of `m` joins the previous one, as in `GetChunkSize` ). The VSD moments are combined
+        with Chan's formula and the VSD is √( ( M2 + n μ² ) / ( n - 1 ) ), the uncentered
+        deviation of `STDΔV`; the bitsets are OR-ed and the Cardinality is their number of
+        bits. The shifts cross the block boundaries instead of wrapping around the segment
+        as `STDΔV` does, a difference of ΔT frames out of a segment.
+
+        **Outputs**
+        - `Cardinality`, `VSD`: nChs × segments; Cardinality is NaN when the sketch has no codes.
+        - `Frames`: First and last frame of every segment.
+"""
+function RebinSketch( filename::String, m::Int )
+    io = open( filename, "r" );
+    nChs, W, _, _, _ = SketchHeader( io );
+    start = position( io );
+    Blocks = SketchBlocks( io, nChs );
+    seek( io, start );
+    B = length( Blocks );
+    G = max( 1, cld( B, m ) );
+    if G > 1 && ( B - ( G - 1 ) * m ) < m / 2
+        G -= 1;
+    end
+    Cardinality = fill( NaN, nChs, G );
+    VSD = fill( NaN, nChs, G );
+    Frames = Tuple{ Int, Int }[ ];
+    nA = 0; μA = zeros( nChs ); M2A = zeros( nChs );
+    Bits = zeros( UInt64, W, nChs );
+    for j in 1:B
+        g = min( cld( j, m ), G );
+        f0, fN, n, nWords = read!( io, Vector{ Int64 }( undef, 4 ) );
+        μ = read!( io, Vector{ Float64 }( undef, nChs ) );
+        M2 = read!( io, Vector{ Float64 }( undef, nChs ) );
+        lo = read!( io, Vector{ Int32 }( undef, nChs ) );
+        nw = read!( io, Vector{ Int32 }( undef, nChs ) );
+        Words = read!( io, Vector{ UInt64 }( undef, nWords ) );
+        length( Frames ) < g && push!( Frames, ( f0, fN ) );
+        Frames[ g ] = ( Frames[ g ][ 1 ], fN );
+        # Chan et al.: the moments of the union from the moments of the parts
+        if n > 0
+            nAB = nA + n;
+            δ = μ .- μA;
+            M2A .+= M2 .+ δ .^ 2 .* ( nA * n / nAB );
+            μA .+= δ .* ( n / nAB );
+            nA = nAB;
+        end
+        p = 0;
+        for c in 1:nChs
+            for w in 1:nw[ c ]
+                Bits[ lo[ c ] + w, c ] |= Words[ p + w ];
+            end
+            p += nw[ c ];
+        end
+        # Last block of the group
+        if j == B || min( cld( j + 1, m ), G ) != g
+            VSD[ :, g ] .= sqrt.( ( M2A .+ nA .* μA .^ 2 ) ./ max( nA - 1, 1 ) );
+            W > 0 && ( Cardinality[ :, g ] .= vec( sum( count_ones, Bits, dims = 1 ) ) );
+            nA = 0; fill!( μA, 0 ); fill!( M2A, 0 ); fill!( Bits, 0 );
+        end
+    end
+    close( io );
+    return Cardinality, VSD, Frames
+end
+
+"""
+    RebinResults( PATHINFO::String, m::Int; colormap::Symbol = :vik ) → G::Int
+        Writes Info/REBIN.res with the Cardinality and VSD of segments of `m` base blocks
+        ( `RebinSketch` ) and the empty channels of STEP00, so the maps are drawn from the
+        store like those of any step. Returns the number of segments.
+"""
+function RebinResults( PATHINFO::String, m::Int; colormap::Symbol = :vik )
+    Cardinality, VSD, Frames = RebinSketch( joinpath( PATHINFO, "Sketch.bin" ), m );
+    nChs, G = size( Cardinality );
+    Empties = StepResults( PATHINFO, "STEP00" )[ "Empties" ];
+    SaveResults( joinpath( PATHINFO, "REBIN.res" ), nChs, G; colormap = colormap,
+        matrices = [ "Cardinality" => [ Cardinality[ :, g ] for g in 1:G ], "VoltageShiftDeviation" => [ VSD[ :, g ] for g in 1:G ] ],
+        lists = [ "Empties" => Empties ] );
+    return G
+end
+
+# ----------------------------------------------------------------------------------------- #
+#                                     Channel pool
+# ----------------------------------------------------------------------------------------- #
+const ChannelBlock = Ref( 64 ); # Channels per task, one row of the array
+const SchedulerPoll = Ref( C_NULL ); # C callback of the GUI scheduler, set only while a batch runs
+const PollInterval = 0.02; # s, between polls of the calling task
+
+"""
+    Cancelled( ) → exception
+        Thrown by the kernels when the GUI cancels the running batch.
+"""
+struct Cancelled <: Exception end
+
+"""
+    PollScheduler( ) → cancelled::Bool
+        Lets the GUI run its pending interactive jobs and tells whether the batch was cancelled.
+
+        **Purpose**
+        Batch segments and interactive requests ( spectrograms, traces ) share the GUI thread,
+        the one that owns Julia. While a batch runs, the GUI publishes its poll function in
+        `SchedulerPoll`; calling it processes the events, runs the queued interactive jobs and
+        returns the cancel flag. Only the first thread may call it, elsewhere it is a no-op.
+
+        **Outputs**
+        - `cancelled`: true once Cancel was pressed.
+
+        **Requirements**
+        - **None**: Base only.
+"""
+function PollScheduler( )
+    ( SchedulerPoll[ ] == C_NULL || Threads.threadid( ) != 1 ) && return false
+    return ccall( SchedulerPoll[ ], Cint, ( ) ) != 0
+end
+
+"""
+    CheckCancel( ) → nothing
+        Polls the scheduler and throws `Cancelled` if the batch was cancelled, for the stage
+        boundaries of the scripts.
+"""
+CheckCancel( ) = PollScheduler( ) ? throw( Cancelled( ) ) : nothing;
+
+"""
+    ForChannels( f::Function, nChs::Int; block::Int = ChannelBlock[ ] ) → nothing
+        Runs `f( chs )` over every block of `block` consecutive channels on the Julia threads.
+
+        **Purpose**
+        Shared scheduler of the per-channel kernels. One task per thread takes the next
+        block from a common counter as soon as it finishes the previous one, so channels
+        with very different amounts of work ( saturations, spikes ) do not leave threads
+        idle as a static partition would. The threads are the ones of the process ( set
+        from the cores by the GUI, optionally pinned ), no kernel starts threads of its own.
+        While a batch runs, the calling task polls the GUI scheduler every `PollInterval`;
+        once it reports Cancel no new block is started and `Cancelled` is thrown, so the
+        response time is one block of channels.
+
+        **Inputs**
+        - `f`: Function of a `UnitRange` of channels. Blocks are disjoint, so `f` may write
+        the rows of its channels without locks.
+        - `nChs`: Number of channels ( or items ) to cover.
+        - `block`: Channels per block.
+
+        **Requirements**
+        - **None**: Base threads only.
+"""
+function ForChannels( f::Function, nChs::Int; block::Int = ChannelBlock[ ] )
+    nB = cld( nChs, block );
+    Block( b ) = ( ( b - 1 ) * block + 1 ):min( b * block, nChs );
+    nT = min( Threads.nthreads( ), nB );
+    if nT <= 1
+        for b in 1:nB
+            CheckCancel( );
+            f( Block( b ) );
+        end
+        return nothing
+    end
+    next = Threads.Atomic{ Int }( 1 );
+    stop = Threads.Atomic{ Bool }( false );
+    tasks = map( 1:nT ) do _
+        Threads.@spawn begin
+            b = Threads.atomic_add!( next, 1 );
+            while b <= nB && !stop[ ]
+                f( Block( b ) );
+                yield( ); # Lets the polling task in when it shares the thread
+                b = Threads.atomic_add!( next, 1 );
+            end
+        end
+    end
+    if SchedulerPoll[ ] != C_NULL
+        while !all( istaskdone, tasks )
+            stop[ ] = stop[ ] || PollScheduler( );
+            sleep( PollInterval );
+        end
+    end
+    foreach( wait, tasks ); # Rethrows the errors of the kernels
+    stop[ ] && throw( Cancelled( ) );
+    return nothing
+end
+
+# ----------------------------------------------------------------------------------------- #
+#                                      Band power
+# ----------------------------------------------------------------------------------------- #
+# Same bands as Channel_Spectrogram, in Hz
+const Bands = [ "delta" => ( 0, 5 ), "theta" => ( 4, 8 ), "alpha" => ( 8, 12 ) ];
+
+"""
+    BandPower( Variables::Dict, BIN::AbstractMatrix, bands::Vector = Bands; block::Int = ChannelBlock[ ] ) → Absolute::Matrix{ Float64 }, Relative::Matrix{ Float64 }
+        Welch power of every channel of a segment in each frequency band.
+
+        **Purpose**
+        Computes the band power of all the channels at once instead of one clicked channel at
+        a time. The channels are split in blocks of `block` rows; every block is transformed
+        window by window with a single FFT plan along the frames ( one row per channel ), and
+        the blocks are distributed over the Julia threads. Windows are Hann tapered, their
+        mean removed, ~1 Hz wide ( nfft = next power of 2 of the sampling rate, or the
+        largest that fits in the segment ) and overlapped by 50 %.
+
+        **Inputs**
+        - `Variables`: Dictionary with the metadata of the BRW file ( `SamplingRate` ).
+        - `BIN`: nChs × nfrs segment in μV.
+        - `bands`: Vector of `name => ( low, high )` pairs in Hz.
+        - `block`: Number of channels transformed together.
+
+        **Outputs**
+        - `Absolute`: nChs × nBands mean power spectral density summed over each band ( μV² ).
+        - `Relative`: nChs × nBands power of each band divided by the total power above DC.
+
+        **Requirements**
+        - **Native Modules**: `DSP`, `FFTW`, `LinearAlgebra`, `StatsBase`
+"""
+function BandPower( Variables::Dict, BIN::AbstractMatrix{ T }, bands::Vector = Bands; block::Int = ChannelBlock[ ] ) where T
+    nChs, nfrs = size( BIN );
+    fs = Variables[ "SamplingRate" ];
+    nfft = min( nextpow( 2, round( Int, fs ) ), prevpow( 2, nfrs ) );
+    starts = 1:( nfft ÷ 2 ):( nfrs - nfft + 1 );
+    taper = Float32.( DSP.hanning( nfft ) );
+    scale = 1 / ( fs * sum( abs2, taper ) * length( starts ) );
+    freqs = rfftfreq( nfft, fs );
+    bins = [ findall( f -> lo <= f <= hi, freqs ) for ( _, ( lo, hi ) ) in bands ];
+    Absolute = zeros( nChs, length( bands ) );
+    Relative = zeros( nChs, length( bands ) );
+    ForChannels( nChs; block = block ) do chs
+        nb = length( chs );
+        buf = Matrix{ Float32 }( undef, nb, nfft );
+        spec = Matrix{ ComplexF32 }( undef, nb, nfft ÷ 2 + 1 );
+        Pxx = zeros( nb, nfft ÷ 2 + 1 );
+        # One plan per block, the planner of FFTW.jl is thread safe
+        plan = plan_rfft( buf, 2 );
+        for s in starts
+            @views buf .= BIN[ chs, s:( s + nfft - 1 ) ];
+            buf .-= mean( buf, dims = 2 );
+            buf .*= taper';
+            mul!( spec, plan, buf );
+            Pxx .+= abs2.( spec );
+        end
+        total = vec( sum( @view( Pxx[ :, 2:end ] ), dims = 2 ) );
+        for ( b, idx ) in enumerate( bins )
+            p = vec( sum( @view( Pxx[ :, idx ] ), dims = 2 ) );
+            Absolute[ chs, b ] .= p .* scale;
+            Relative[ chs, b ] .= p ./ max.( total, eps( ) );
+        end
+    end
+    return Absolute, Relative
+end
+
+"""
+    PairResults( filename::String, nChs::Int, N::Int, Left::Vector, Right::Vector, Empties::Vector; colormap::Symbol = :vik ) → filename
+        Writes the maps of every segment of one view as a results store: "Left" for the left
+        viewer and "Right" for the right one, with the empty channels. The GUI draws them
+        from the store ( z-scored, as STEP00 ), so no figure is rendered per segment.
+"""
+function PairResults( filename::String, nChs::Int, N::Int, Left::Vector, Right::Vector, Empties::Vector; colormap::Symbol = :vik )
+    return SaveResults( filename, nChs, N; colormap = colormap, matrices = [ "Left" => Left, "Right" => Right ], lists = [ "Empties" => Empties ] );
+end
+
+"""
+    BandResults( PATHINFO::String, nChs::Int, N::Int, Absolute::Vector, Relative::Vector, Empties::Vector; colormap::Symbol = :vik, bands::Vector = Bands )
+        One store per band, `Info/<BAND>.res`: the log10 absolute power on the left and the
+        relative power on the right. Segments without results stay empty.
+"""
+function BandResults( PATHINFO::String, nChs::Int, N::Int, Absolute::Vector, Relative::Vector, Empties::Vector; colormap::Symbol = :vik, bands::Vector = Bands )
+    for ( b, ( band, _ ) ) in enumerate( bands )
+        Left = [ isempty( A ) ? [ ] : log10.( A[ :, b ] .+ eps( ) ) for A in Absolute ];
+        Right = [ isempty( R ) ? [ ] : R[ :, b ] for R in Relative ];
+        PairResults( joinpath( PATHINFO, string( uppercase( band ), ".res" ) ), nChs, N, Left, Right, Empties; colormap = colormap );
+    end
+end
+
+# ----------------------------------------------------------------------------------------- #
+#                                        Spikes
+# ----------------------------------------------------------------------------------------- #
+"""
+    SpikeDetect( Variables::Dict, BIN::Matrix{ UInt16 }; k::Real = 5, fc::Real = 300, refractory::Real = 1, timestamps::Bool = false, fr0::Int = 1, block::Int = 64 ) → Rates::Vector{ Float64 }, Noise::Vector{ Float64 }, Times
+        Threshold-crossing spike detection on the raw ADC codes of a segment.
+
+        **Purpose**
+        Runs over the `UInt16` block read by `OneSegment`, before the conversion to μV, so it
+        adds two light passes per segment. Every channel is high-passed with a one-pole filter
+        ( cut-off `fc` ), its noise is the MAD of ~2048 evenly spaced filtered samples
+        ( σ = MAD / 0.6745 ), and a spike is counted each time the filtered signal leaves
+        ±`k`σ, at least `refractory` ms after the previous one. The inner loops run over
+        the channels of a frame, which are contiguous in memory, so they vectorize; blocks
+        of `block` channels are distributed over the Julia threads.
+
+        **Inputs**
+        - `Variables`: Dictionary with the metadata of the BRW file.
+        - `BIN`: nChs × nfrs segment in ADC codes.
+        - `k`: Threshold in units of the noise.
+        - `fc`: Cut-off of the high-pass filter in Hz.
+        - `refractory`: Minimum time between two spikes of a channel in ms.
+        - `timestamps`: Whether the frames of every spike are also returned.
+        - `fr0`: First frame of the segment in the recording, to report absolute frames.
+
+        **Outputs**
+        - `Rates`: Firing rate of each channel in Hz.
+        - `Noise`: σ of each channel in μV.
+        - `Times`: Vector with the frames of the spikes of each channel, or `nothing`.
+
+        **Requirements**
+        - **Native Modules**: `StatsBase`
+"""
+function SpikeDetect( Variables::Dict, BIN::Matrix{ UInt16 }; k::Real = 5, fc::Real = 300, refractory::Real = 1, timestamps::Bool = false, fr0::Int = 1, block::Int = 64 )
+    nChs, nfrs = size( BIN );
+    fs = Variables[ "SamplingRate" ];
+    ADCCountsToMV = ( Variables[ "SignalInversion" ] * ( Variables[ "MaxVolt" ] - Variables[ "MinVolt" ] ) ) / ( 2 ^ Variables[ "BitDepth" ] );
+    α = Float32( 1 - exp( -2π * fc / fs ) );
+    refr = ms2frs( refractory, fs );
+    stride = max( 1, nfrs ÷ 2048 );
+    nS = nfrs ÷ stride;
+    Rates = zeros( nChs );
+    Noise = zeros( nChs );
+    Times = timestamps ? [ Int[ ] for _ in 1:nChs ] : nothing;
+    ForChannels( nChs; block = block ) do chs
+        c0 = first( chs ) - 1;
+        nb = length( chs );
+        base = Float32.( BIN[ chs, 1 ] );
+        # Noise, from evenly spaced samples of the filtered signal
+        S = Matrix{ Float32 }( undef, nb, nS );
+        for f in 1:( nS * stride )
+            @inbounds @simd for i in 1:nb
+                base[ i ] += α * ( Float32( BIN[ c0 + i, f ] ) - base[ i ] );
+            end
+            if f % stride == 0
+                j = f ÷ stride;
+                @inbounds for i in 1:nb
+                    S[ i, j ] = Float32( BIN[ c0 + i, f ] ) - base[ i ];
+                end
+            end
+        end
+        σ = [ mad( @view( S[ i, : ] ), normalize = true ) for i in 1:nb ];
+        thr = Float32.( k .* max.( σ, 1 ) );
+        # Crossings
+        base .= Float32.( BIN[ chs, 1 ] );
+        last = fill( -refr, nb );
+        count = zeros( Int, nb );
+        above = zeros( Bool, nb );
+        for f in 1:nfrs
+            @inbounds @simd for i in 1:nb
+                y = Float32( BIN[ c0 + i, f ] ) - base[ i ];
+                base[ i ] += α * y;
+                out = abs( y ) > thr[ i ];
+                hit = out & !above[ i ] & ( f - last[ i ] > refr );
+                count[ i ] += hit;
+                last[ i ] = ifelse( hit, f, last[ i ] );
+                above[ i ] = out;
+            end
+            if timestamps
+                for i in 1:nb
+                    last[ i ] == f && push!( Times[ c0 + i ], fr0 + f - 1 );
+                end
+            end
+        end
+        Rates[ chs ] .= count ./ ( nfrs / fs );
+        Noise[ chs ] .= σ .* abs( ADCCountsToMV );
+    end
+    return Rates, Noise, Times
+end
+
+# ----------------------------------------------------------------------------------------- #
+#                                     Connectivity
+# ----------------------------------------------------------------------------------------- #
+"""
+    ChannelCorrelation( Variables::Dict, BIN::AbstractMatrix; channels, rate::Real = 1000, d::Int = 1, block::Int = 256 ) → Local::Vector{ Float64 }, Global::Vector{ Float64 }
+        Pearson correlation between every pair of channels of a segment, reduced to two maps.
+
+        **Purpose**
+        The nChs × nChs correlation matrix is the product Z Zᵀ of the channels centered and
+        scaled to unit norm. The channels are first decimated to ~`rate` Hz by averaging
+        consecutive frames ( the mean is also the anti-aliasing filter ) into a Float32
+        matrix, so the product runs in single precision over far fewer columns. It is computed
+        in strips of `block` channels against the channels that follow them ( the matrix is
+        symmetric ), one BLAS call per strip on the Julia threads, and every strip is reduced
+        as soon as it is produced: the full matrix ( 64 MB in Float32 for 4096 channels ) is
+        never stored.
+
+        **Inputs**
+        - `Variables`: Dictionary with the metadata of the BRW file ( `SamplingRate` ).
+        - `BIN`: nChs × nfrs segment in μV.
+        - `channels`: Channel of each row of `BIN`, for the neighbourhoods ( the ones kept by
+        `Restrict!`, all by default ).
+        - `rate`: Sampling rate of the decimated channels in Hz.
+        - `d`: Radius of the neighbourhood on the array, as in `Neighbours`.
+        - `block`: Channels per strip.
+
+        **Outputs**
+        - `Local`: Mean correlation of each channel with its d-neighbourhood.
+        - `Global`: Mean absolute correlation of each channel with all the others.
+        Flat channels ( no variance ) are 0 in both and left out of the means of the others.
+
+        **Requirements**
+        - **Native Modules**: `LinearAlgebra`
+"""
+function ChannelCorrelation( Variables::Dict, BIN::AbstractMatrix{ T }; channels = get( Variables, "Channels", 1:size( BIN, 1 ) ), rate::Real = 1000, d::Int = 1, block::Int = 256 ) where T
+    nChs, nfrs = size( BIN );
+    side = round( Int, sqrt( Variables[ "nChs" ] ) );
+    dec = max( 1, floor( Int, Variables[ "SamplingRate" ] / rate ) );
+    m = nfrs ÷ dec;
+    # Decimated channels, the frames of a block of rows are contiguous in BIN
+    Z = zeros( Float32, nChs, m );
+    valid = zeros( Bool, nChs );
+    ForChannels( nChs ) do chs
+        for t in 1:m, f in ( ( t - 1 ) * dec + 1 ):( t * dec )
+            @inbounds for c in chs
+                Z[ c, t ] += BIN[ c, f ];
+            end
+        end
+        for c in chs
+            row = @view Z[ c, : ];
+            row .-= sum( row ) / m;
+            s = norm( row );
+            valid[ c ] = s > 0;
+            row .*= valid[ c ] ? 1 / s : 0;
+        end
+    end
+    # Partial sums of each strip, reduced at the end so no two tasks write the same column
+    nB = cld( nChs, block );
+    SumAbs = zeros( nChs, nB );
+    SumLocal = zeros( nChs, nB );
+    NLocal = zeros( nChs, nB );
+    nBLAS = BLAS.get_num_threads( );
+    Threads.nthreads( ) > 1 && BLAS.set_num_threads( 1 ); # The strips already use the threads
+    try
+        ForChannels( nChs; block = block ) do chs
+            b = cld( first( chs ), block );
+            rest = first( chs ):nChs;
+            S = @views Z[ chs, : ] * transpose( Z[ rest, : ] );
+            for ( k, j ) in enumerate( rest )
+                valid[ j ] || continue;
+                xj, yj = ( channels[ j ] - 1 ) % side, ( channels[ j ] - 1 ) ÷ side;
+                for ( i, c ) in enumerate( chs )
+                    ( c < j && valid[ c ] ) || continue;
+                    r = Float64( S[ i, k ] );
+                    SumAbs[ c, b ] += abs( r ); SumAbs[ j, b ] += abs( r );
+                    if abs( ( channels[ c ] - 1 ) % side - xj ) <= d && abs( ( channels[ c ] - 1 ) ÷ side - yj ) <= d
+                        SumLocal[ c, b ] += r; SumLocal[ j, b ] += r;
+                        NLocal[ c, b ] += 1; NLocal[ j, b ] += 1;
+                    end
+                end
+            end
+        end
+    finally
+        BLAS.set_num_threads( nBLAS );
+    end
+    Global = vec( sum( SumAbs, dims = 2 ) ) ./ max( count( valid ) - 1, 1 );
+    Local = vec( sum( SumLocal, dims = 2 ) ) ./ max.( vec( sum( NLocal, dims = 2 ) ), 1 );
+    return Local, Global
+end
+
+# ----------------------------------------------------------------------------------------- #
+#                                      Filter bank
+# ----------------------------------------------------------------------------------------- #
+# Cascaded biquads ( transposed direct form II ) with the state of every channel, so the
+# filter runs across segment boundaries as if the recording were one block.
+mutable struct FilterBank
+    sos::Matrix{ Float64 } # nSections × 5: b0, b1, b2, a1, a2 ( gain folded in the first )
+    z1::Matrix{ Float64 }  # nChs × nSections
+    z2::Matrix{ Float64 }  # nChs × nSections
+    q::Float64             # μV per ADC code, the output is kept on the grid of the codes
+end
+
+"""
+    FilterDesign( Variables::Dict, kind::String, f1::Real, f2::Real; order::Int = 2 ) → F::Union{ FilterBank, Nothing }
+        Designs the filter selected in the GUI as second order sections.
+
+        **Purpose**
+        Builds the biquad cascade applied by `FilterSegment!` before the metrics. `Bandpass`
+        is a Butterworth filter between `f1` and `f2` Hz ( `order` sections ), `Notch` removes
+        `f1` Hz with a width of `f2` Hz. The state of every channel starts at zero.
+
+        **Inputs**
+        - `Variables`: Dictionary with the metadata of the BRW file.
+        - `kind`: "None", "Bandpass" or "Notch".
+        - `f1`, `f2`: Cut-offs ( Bandpass ) or centre and width ( Notch ) in Hz.
+
+        **Outputs**
+        - `F`: The filter bank, or `nothing` for "None".
+
+        **Requirements**
+        - **Native Modules**: `DSP`
+"""
+function FilterDesign( Variables::Dict, kind::String, f1::Real, f2::Real; order::Int = 2 )
+    fs = Variables[ "SamplingRate" ];
+    nyq = fs / 2;
+    if kind == "Bandpass"
+        design = digitalfilter( Bandpass( f1 / nyq, min( f2, 0.99 * nyq ) / nyq ), Butterworth( order ) );
+    elseif kind == "Notch"
+        design = iirnotch( f1 / nyq, f2 / nyq );
+    else
+        return nothing
+    end
+    SOS = convert( SecondOrderSections, design );
+    sos = [ [ bq.b0 bq.b1 bq.b2 bq.a1 bq.a2 ] for bq in SOS.biquads ];
+    sos = vcat( sos... );
+    sos[ 1, 1:3 ] .*= SOS.g;
+    nChs = Variables[ "nChs" ];
+    q = abs( Variables[ "MaxVolt" ] - Variables[ "MinVolt" ] ) / ( 2 ^ Variables[ "BitDepth" ] );
+    return FilterBank( sos, zeros( nChs, size( sos, 1 ) ), zeros( nChs, size( sos, 1 ) ), q )
+end
+
+"""
+    FilterSegment!( F::FilterBank, BIN::Matrix{ Float64 }; block::Int = ChannelBlock[ ] ) → BIN
+        Filters a segment in place and keeps the state for the next one.
+        The inner loop runs over the channels of one frame ( contiguous in memory ), so each
+        SIMD lane carries one channel through the whole cascade; blocks of channels run on
+        the Julia threads. The output is rounded to the ADC step so `UniqueCount` keeps
+        counting voltage levels.
+"""
+function FilterSegment!( F::FilterBank, BIN::Matrix{ Float64 }; block::Int = ChannelBlock[ ] )
+    nChs, nfrs = size( BIN );
+    nS = size( F.sos, 1 );
+    z1 = F.z1; z2 = F.z2; q = F.q;
+    ForChannels( nChs; block = block ) do chs
+        for f in 1:nfrs
+            for s in 1:nS
+                b0, b1, b2, a1, a2 = F.sos[ s, 1 ], F.sos[ s, 2 ], F.sos[ s, 3 ], F.sos[ s, 4 ], F.sos[ s, 5 ];
+                @inbounds @simd for i in chs
+                    x = BIN[ i, f ];
+                    y = b0 * x + z1[ i, s ];
+                    z1[ i, s ] = b1 * x - a1 * y + z2[ i, s ];
+                    z2[ i, s ] = b2 * x - a2 * y;
+                    BIN[ i, f ] = y;
+                end
+            end
+            @inbounds @simd for i in chs
+                BIN[ i, f ] = round( BIN[ i, f ] / q ) * q;
+            end
+        end
+    end
+    return BIN
+end
+
+# ----------------------------------------------------------------------------------------- #
+#                              Julia auxiliar functions for Qt
+# ----------------------------------------------------------------------------------------- #
+"""
+    ChunkSizeSpace( Variables::Dict, limupper::Real ) -> σ::Int
+        Determina el numero de segmentos en los que el dataset se debe recortar considerando el tamano en espacio de disco que ocupara cada uno. limupper es el tamano maximo establecido por el usuario en GB.
+"""
+function optimal_file_size(Variables::Dict, limupper::Real)
+    NRecFrames = Variables["NRecFrames"]
+    σ = max(1, Int(floor(Variables["dsetsize"] / limupper)))
+    finalsize = Variables["dsetsize"] / σ
     upper_tolerance = limupper * 1.15
     flagQtUI = 0
 
@@ -1369,6 +2980,211 @@ function ChunkSizeSpace(Variables::Dict, limupper::Real)
     return σ, ft, fs, flagQtUI
 end
 
+# Working set of one segment relative to its raw UInt16 size until a run of the session has
+# been measured: the Float64 copy ( ×4 ) and a few whole-segment temporaries, with ample slack.
+# After every run `Amplification` holds what its segments really needed ( CalibrateAmplification! )
+const MemoryAmplification = 20;
+const Amplification = Ref{ Float64 }( MemoryAmplification );
+
+"""
+    SegmentBudget( BudgetGB::Real ) → MaxSegGB::Float64
+        Raw size in GB that one segment may have so that processing it keeps the whole
+        process within `BudgetGB`. The memory in use now ( `CurrentRSS` ) is discounted first;
+        at least 10 % of the budget is always left for the segments.
+"""
+function SegmentBudget( BudgetGB::Real )
+    BaselineGB = CurrentRSS( ) / ( 1024 ^ 3 );
+    Available = max( BudgetGB - BaselineGB, 0.1 * BudgetGB );
+    if BudgetGB - BaselineGB < 0.1 * BudgetGB
+        println( "MaxGB ( $BudgetGB GB ) is close to the memory already in use ( ",
+            round( BaselineGB, digits = 2 ), " GB )" );
+    end
+    return Available / Amplification[ ]
+end
+
+"""
+    EstimateMemory( fs::Real ) → GB::Float64
+        Expected peak memory of the process while processing segments of `fs` GB.
+"""
+EstimateMemory( fs::Real ) = CurrentRSS( ) / ( 1024 ^ 3 ) + fs * Amplification[ ];
+
+"""
+    CurrentRSS( ) → bytes::Int
+        Resident memory of the process now. `Sys.maxrss` is the high-water mark of the whole
+        session, one large run would shrink every later budget. Read from /proc/self/statm on
+        Linux and GetProcessMemoryInfo on Windows; the live Julia heap elsewhere.
+"""
+function CurrentRSS( )
+    if Sys.islinux( )
+        statm = try split( read( "/proc/self/statm", String ) ) catch; String[ ] end
+        length( statm ) >= 2 && return parse( Int, statm[ 2 ] ) * ccall( :getpagesize, Cint, ( ) )
+    elseif Sys.iswindows( )
+        # PROCESS_MEMORY_COUNTERS: cb and PageFaultCount ( UInt32 ), then 8 SIZE_T, the 2nd is
+        # the working set
+        pmc = zeros( UInt64, 9 ); pmc[ 1 ] = UInt64( sizeof( pmc ) );
+        process = ccall( ( :GetCurrentProcess, "kernel32" ), stdcall, Ptr{ Cvoid }, ( ) );
+        ok = ccall( ( :K32GetProcessMemoryInfo, "kernel32" ), stdcall, Cint, ( Ptr{ Cvoid }, Ptr{ UInt64 }, UInt32 ), process, pmc, sizeof( pmc ) );
+        ok != 0 && return Int( pmc[ 3 ] )
+    end
+    return Int( Base.gc_live_bytes( ) )
+end
+
+"""
+    SegmentMemory( gc0::Base.GC_Num, t0::UInt64, peak0::Integer ) → D::Dict
+        Memory and GC statistics of one segment, measured from the counters `gc0 = Base.gc_num( )`,
+        `t0 = time_ns( )` and `peak0 = Sys.maxrss( )` taken at its start. `RSS` is the resident
+        memory after the segment and `PeakΔ` how much the segment raised the high-water mark of
+        the process ( 0 when it stayed below an earlier peak ), both in GB. `Peak` is the
+        highest resident memory seen in the segment: the new high-water mark when it set one
+        ( exact ), otherwise only `RSS` ( a lower bound ).
+"""
+function SegmentMemory( gc0::Base.GC_Num, t0::UInt64, peak0::Integer )
+    diff = Base.GC_Diff( Base.gc_num( ), gc0 );
+    peak = Sys.maxrss( );
+    rss = CurrentRSS( );
+    D = Dict(
+        "RSS"      => rss / ( 1024 ^ 3 ),
+        "PeakΔ"    => ( peak - peak0 ) / ( 1024 ^ 3 ),
+        "Peak"     => ( peak > peak0 ? max( peak, rss ) : rss ) / ( 1024 ^ 3 ),
+        "LiveGB"   => Base.gc_live_bytes( ) / ( 1024 ^ 3 ),
+        "AllocGB"  => diff.allocd / ( 1024 ^ 3 ),
+        "GCTime"   => diff.total_time / 1e9,
+        "GCPauses" => diff.pause,
+        "Time"     => ( time_ns( ) - t0 ) / 1e9
+    );
+    return D
+end
+
+"""
+    RunPeak( Log::AbstractVector ) → GB::Float64
+        Highest resident memory of the segments of one run, from their `SegmentMemory` entries
+        ( the ones cut short are empty and skipped ), 0 without any. Unlike `Sys.maxrss` it
+        does not report the peak of an earlier, larger run of the session.
+"""
+function RunPeak( Log::AbstractVector )
+    Logged = filter( D -> D isa AbstractDict, Log );
+    isempty( Logged ) && return 0.0
+    return maximum( D -> get( D, "Peak", D[ "RSS" ] ), Logged )
+end
+
+"""
+    CalibrateAmplification!( Log::AbstractVector, BaselineGB::Real, SegmentGB::Real ) → Float64
+        Replaces `Amplification` with the working set per raw GB that the segments of a run
+        needed: the memory each one raised the process to over `BaselineGB`, the resident
+        memory before the run, divided by the raw size of a segment `SegmentGB`. Only segments
+        that set a new high-water mark count, their peak is exact; without any ( a larger run
+        came first ) the value stays. A quarter of slack is added, and it is never below the
+        Float64 copy of the segment ( ×4 ).
+"""
+function CalibrateAmplification!( Log::AbstractVector, BaselineGB::Real, SegmentGB::Real )
+    Exact = filter( D -> D isa AbstractDict && get( D, "PeakΔ", 0 ) > 0 && haskey( D, "Peak" ), Log );
+    if !isempty( Exact ) && SegmentGB > 0
+        Measured = ( maximum( D -> D[ "Peak" ], Exact ) - BaselineGB ) / SegmentGB;
+        Amplification[ ] = max( 1.25 * Measured, 4.0 );
+        println( "Memory: ", round( Measured, digits = 1 ), " GB per raw GB of segment, budget uses ",
+            round( Amplification[ ], digits = 1 ) );
+    end
+    return Amplification[ ]
+end
+
+"""
+    MemoryThrottle( BudgetGB::Real ) → Nothing
+        Collects garbage between segments when the live Julia heap passes half of the budget,
+        so the GC lag never piles several segments worth of temporaries on top of each other.
+"""
+function MemoryThrottle( BudgetGB::Real )
+    lim = 0.5 * BudgetGB * ( 1024 ^ 3 );
+    if Base.gc_live_bytes( ) > lim
+        GC.gc( false );
+        if Base.gc_live_bytes( ) > lim
+            GC.gc( true );
+        end
+    end
+    return nothing
+end
+
+"""
+    AutotuneSegments( Variables::Dict, MaxGB::Real, Δt::Real; m::Int = 3, M::Int = 500, trials::Int = 5 ) ⤵
+        → frames::Int, Report::String
+
+        Segment length ( whole HDF5 chunks ) with the highest measured throughput.
+
+        **Purpose**
+        `GetChunkSize` takes the largest segment that `MaxGB` allows, but the largest is not
+        always the fastest: the kernels may fall out of the caches, and the OS page cache
+        may be evicted when the free RAM runs low. Small segments, in turn, pay the fixed
+        cost of their maps more often. The candidates form a ladder that halves `trials`
+        times from the largest segment allowed by `MaxGB`, the RAM free right now and `m`.
+        They never go below one chunk or below the size that gives `M` segments. Each one
+        is timed on its own frames from the start of the recording ( or of the window ),
+        so the page cache filled by one does not speed up the next. The timing covers the
+        read, the conversion to μV, `UniqueCount` and `STDΔV`, plus the cost of the two
+        STEP00 maps of a segment, measured once. The smallest candidate within 5 % of the
+        best throughput wins, as it needs the least memory. The kernels poll the GUI like a
+        batch, so a Cancel throws `Cancelled` after closing the file.
+
+        **Inputs**
+        - `Variables`: Dictionary with the metadata of the BRW file.
+        - `MaxGB`, `m`, `M`: As in `GetChunkSize`.
+        - `Δt`: Shift of the VSD in ms, candidates must be longer.
+        - `trials`: Number of candidates.
+
+        **Outputs**
+        - `frames`: For `GetChunkSize( ...; frames )`, 0 when no candidate fits.
+        - `Report`: The throughput of every candidate and the free RAM.
+
+        **Requirements**
+        - **Custom Functions**: `SegmentBudget`, `CurrentRSS`, `OpenRaw`, `FrameRange`,
+        `Digital2Analogue`, `UniqueCount`, `STDΔV`, `Zplot`
+"""
+function AutotuneSegments( Variables::Dict, MaxGB::Real, Δt::Real; m::Int = 3, M::Int = 500, trials::Int = 5 )
+    fw0, fwN = get( Variables, "Window", ( 1, Int( Variables[ "NRecFrames" ] ) ) );
+    cf = get( Variables, "ChunkFrames", 1 );
+    fs = Variables[ "SamplingRate" ];
+    oneframe = Variables[ "dsetsize" ] / Variables[ "NRecFrames" ];
+    nChunks = cld( fwN - fw0 + 1, cf );
+    FreeGB = Sys.free_memory( ) / ( 1024 ^ 3 );
+    # The free RAM bounds the budget as much as MaxGB does
+    BudgetGB = SegmentBudget( min( MaxGB, FreeGB + CurrentRSS( ) / ( 1024 ^ 3 ) ) );
+    kmax = min( floor( Int, BudgetGB / ( oneframe * cf ) ), fld( nChunks, max( m, 1 ) ) );
+    kmin = max( 1, cld( nChunks, M ) );
+    ΔT = ms2frs( Δt, Variables );
+    Ladder = filter( L -> L > ΔT, sort( unique( [ max( kmin, kmax >> i ) * cf for i in 0:( trials - 1 ) ] ) ) );
+    if kmax < kmin || isempty( Ladder )
+        return 0, "Autotune: no segment length fits MaxGB and the free RAM"
+    end
+    RAW = OpenRaw( Variables; sequential = false );
+    TMP = mktempdir( );
+    Kernels( B ) = ( X = Digital2Analogue( Variables, B ); UniqueCount( X ); STDΔV( Variables, X, Δt ) );
+    Maps( ) = Plots.png( plot( Zplot( ZscoreFinite( rand( Variables[ "nChs" ] ) ) ), wsize = ( 64, 64 ), cbar = false, margins = -2mm ), joinpath( TMP, "autotune" ) );
+    Rates = Float64[ ];
+    Lines = String[ ];
+    try
+        # Compiled before anything is timed
+        Kernels( FrameRange( RAW, Variables, fw0, min( fwN, fw0 + 2 * ΔT ) ) );
+        Maps( );
+        Fixed = 2 * @elapsed Maps( );
+        fr = fw0;
+        for L in Ladder
+            fr + L - 1 > fwN && ( fr = fw0 );
+            GC.gc( false );
+            t = @elapsed Kernels( FrameRange( RAW, Variables, fr, fr + L - 1 ) );
+            fr += L;
+            push!( Rates, L / fs / ( t + Fixed ) );
+            push!( Lines, string( round( L / fs, digits = 2 ), " s ( ", round( L * oneframe, digits = 3 ), " GB ): ",
+                round( Rates[ end ], digits = 1 ), " s of recording per s" ) );
+        end
+    finally
+        CloseRaw( RAW );
+        rm( TMP; recursive = true, force = true );
+    end
+    k = findfirst( r -> r >= 0.95 * maximum( Rates ), Rates );
+    Lines[ k ] *= "  <- chosen";
+    Report = string( "Autotune ( read + kernels + maps ):\n", join( Lines, "\n" ),
+        "\nFree RAM: ", round( FreeGB, digits = 1 ), " GB" );
+    return Ladder[ k ], Report
+end
+
 """
     convgauss( sigma::Real, h::Vector ) -> hg::Vector'
         Convolution between a gaussian function and a vector
@@ -1394,6 +3210,17 @@ function RemoveInfs( data::VecOrMat )
     return data
 end
 
+"""
+    ZscoreFinite( data::Vector ) → z::Vector{ Float64 }
+        zscore over the finite entries only, the others ( channels outside a ROI ) stay NaN
+"""
+function ZscoreFinite( data::Vector )
+    valid = isfinite.( data );
+    z = fill( NaN, length( data ) );
+    z[ valid ] = zscore( Float64.( data[ valid ] ) );
+    return z
+end
+
 # ----------------------------------------------------------------------------------------- #
 end # module AllSTEPs
 # ----------------------------------------------------------------------------------------- #
\ No newline at end of file
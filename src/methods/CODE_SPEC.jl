@@ -31,14 +31,16 @@ PATHFIGURES_STEP01 = joinpath( PATHFIGURES, "STEP01" ); mkpath( PATHFIGURES_STEP
 PATHFIGURES_GENERAL = joinpath( PATHFIGURES, "GENERAL" ); mkpath( PATHFIGURES_GENERAL );
 
 FILEVARIABLES = joinpath( PATHINFO, "Variables.jld2" );
-FILESTEP00 = joinpath( PATHMAIN, "Info", "STEP00.jld2" );
 FILEPARAMETERS = joinpath( PATHINFO, "Parameters.jld2" );
 
 Variables = LoadDict( FILEVARIABLES );
-step00 = LoadDict( FILESTEP00 );
 Parameters = LoadDict( FILEPARAMETERS );
 
 N = Parameters[ "N" ];
+Variables[ "SegmentFrames" ] = get( Parameters, "nfrs", floor( Int, Variables[ "NRecFrames" ] / N ) );
+haskey( Parameters, "Window" ) && ( Variables[ "Window" ] = Parameters[ "Window" ] ); # Same frames as STEP00
+# Segments come from the BRW when STEP00 did not dump them, or dumped only the channels of a ROI
+Streaming = !get( Parameters, "SaveBIN", true ) || haskey( Parameters, "Channels" );
 n0s = length( string( N ) );
 
 #segment = 1;
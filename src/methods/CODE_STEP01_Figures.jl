@@ -7,9 +7,11 @@
     https://github.com/LBitn/Hippocampus-HDMEA-CSDA.git
 """
 BINNAME = joinpath( PATHSTEP00, string( "BIN", lpad( n, n0s, "0" ), ".jld2" ) );
-BINRAW = Float64.( LoadDict( BINNAME ) ); # Load the n-segment in Float64
-nChs, nFrs = size( BINRAW );
-BINPATCH = deepcopy( BINRAW );
+fr0, frN = SegmentFrames( Variables, n, N );
+nChs, nFrs = Variables[ "nChs" ], frN - fr0 + 1;
+# Both segments live in the arena buffers of the GUI, nothing is allocated per segment
+BINRAW = LoadSegment!( ArenaMatrix( ARENA_RAW, nChs, nFrs ), Variables, BINNAME, n, N, Streaming ); # Load the n-segment in Float64
+BINPATCH = copyto!( ArenaMatrix( ARENA_PATCH, nChs, nFrs ), BINRAW );
 BINPATCH[ Empties, : ] .= 0; # Discarded channels are flattened to 0
 
 SatChs, SatFrs = SupThr( BINRAW, THR_SES );
@@ -58,20 +60,14 @@ Repaired[ n ] = Dict(
     "Frs" => Frs4Repair
 );
 
-for emptie in Empties
-    rad = 1
-    _, neigh = Neighbours( emptie, rad );
-    while length( neigh ) <= minchan && rad <= maxrad
-        rad = rad + 1;
-        _, neigh = Neighbours( emptie, rad );
-    end
-    neighs = sort( sample( neigh, minchan, replace = false ) );
-    BINNEIGHS = BINPATCH[ neighs, : ];
-    fictional_channel = ReconstructChannels( BINNEIGHS, maxIt );
-    BINPATCH[ emptie, : ] = fictional_channel;
+CheckCancel( ); # Stage boundary: a cancelled batch stops here, pending clicks run here
+ReconstructEmpties!( BINPATCH, Empties, minchan, maxrad, maxIt ); # Each one may build on the previous ones
+
+if SaveBIN
+    jldsave( replace( BINNAME, "STEP00" => "STEP01" ); Data = Float16.( BINPATCH ) );
 end
 
-jldsave( replace( BINNAME, "STEP00" => "STEP01" ); Data = Float16.( BINPATCH ) );
+isnothing( Filter ) || FilterSegment!( Filter, BINPATCH ); # Optional biquad stage before the metrics
 
 CAR = [ ];
 VSD = [ ];
@@ -85,42 +81,9 @@ SecondEvaluation = Dict(
 Cardinality[ n ] = SecondEvaluation[ "Cardinality" ];
 VoltageShiftDeviation[ n ] = SecondEvaluation[ "VoltageShiftDeviation" ];
 
-# Cardinality
-P0 = plot( );
-data = zscore( PatchEmpties( CAR, Empties ) );
-P0 = Zplot( data, cm_, false, "\n" ^ 2 * "Cardinality of the Voltage" );
-
-# GUI Figures code....
-PP0 = plot();
-PP0 = Zplot( data, cm_, true ); #   -> PP = Zplot( data, cm_, true, "", clims = c::Real = 0);
-PPF = plot( PP0, wsize = ( 64, 64 ), cbar = false, margins = -2mm );
-FIGNAME = joinpath( PATHFIGURES_STEP01, string( "BIN", lpad( n, n0s, "0" ), "_" ) );
-Plots.png( PPF, FIGNAME );
-
-# VoltageShiftDeviation
-P1 = plot( );
-data = zscore( PatchEmpties( VSD, Empties ) );
-P1 = Zplot( data, cm_, false, "\n" ^ 2 * "Voltage Shift Deviation" );
-
-# GUI Figures code....
-PP1 = plot();
-PP1 = Zplot( data, cm_, true ); #   -> PP = Zplot( data, cm_, true, "", clims = c::Real = 0);
-PPF = plot( PP1, wsize = ( 64, 64 ), cbar = false, margins = -2mm );
-FIGNAME = joinpath( PATHFIGURES_STEP01, string( "BIN", lpad( n, n0s, "0" ), "_std" ) );
-Plots.png( PPF, FIGNAME );
-
-# Final Figure
-P = plot( );
-P = plot( P0, P1, layout = l, wsize = ( 800, 400 ) );
-title = plot( );
-title = plot( title = "\n" ^ 2 * "Second evaluation, Repaired Data", grid = false, showaxis = false, bottom_margin = -50Plots.px );
-
-F = plot( );
-F = plot( title, P, layout = @layout( [ A{ 0.1h }; B{ 0.9h } ] ), wsize = ( 800, 500 ), titlefont = plotfonts, );
-
-FILEFIGURE_STEP01 = joinpath( PATHFIGURES_STEP01, string( "BIN", lpad( n, n0s, "0" ) ) );
-Plots.png( F, FILEFIGURE_STEP01 );
+CheckCancel( );
 
+# The maps and the composite are drawn by the GUI from STEP01.res, see FigureExport
 println("$n listo de $N");
 
 # aux code...
@@ -43,14 +43,33 @@ println("Δt Julia: ", Δt);
 println("n1 Julia: ", n1);
 println("n_overlap1 Julia: ", n_overlap1);
 println("minSegments: ", minSegments);
+println("SaveBIN: ", SaveBIN);
+println("SpikeTimestamps: ", SpikeTimestamps);
+println("Connectivity: ", Connectivity);
+println("Filter: ", FilterKind, " ", FilterLow, " ", FilterHigh);
+println("Window: ", WindowStart, " - ", WindowEnd, " s, ROI channels: ", length( RoiChannels ));
 
 # •·•·•·•·•·•·•·•·•·••·•·•·•·•·•·•·•·•·••·•·•·•·•·•·•·•·•·••·•·•·•·•·•·•·•·•·••·•·•·•·•·•·• #
 # Obtaining the metadata of the selected file
 # •·•·•·•·•·•·•·•·•·••·•·•·•·•·•·•·•·•·••·•·•·•·•·•·•·•·•·••·•·•·•·•·•·•·•·•·••·•·•·•·•·•·• #
 Variables = GetVarsHDF5( FILEBRW );
-
-N, ft, fs, flagQtUI = GetChunkSize( Variables, MaxGB, minSegments);
+Restrict!( Variables, WindowStart, WindowEnd, RoiChannels ); # After Variables.jld2, STEP01 takes them from Parameters
+Restricted = haskey( Variables, "Window" ) || haskey( Variables, "Channels" ); # The trace pyramid covers whole recordings only
+# Segments come from the BRW when STEP00 does not dump them, or dumps only the channels of a ROI
+Streaming = !SaveBIN || haskey( Variables, "Channels" );
+
+# Optional: the segment length with the best measured throughput instead of the largest one
+# ( the GUI shows a progress dialog meanwhile, its Cancel falls back to the largest )
+TuneFrames, TuneReport = try
+    Autotune ? AutotuneSegments( Variables, MaxGB, Δt; m = minSegments ) : ( 0, "" )
+catch e
+    e isa Cancelled || rethrow( );
+    ( 0, "Autotune: cancelled, largest segment used" )
+end
+N, ft, fs, flagQtUI = GetChunkSize( Variables, MaxGB, minSegments; frames = TuneFrames, minframes = 2 * ms2frs( Δt, Variables ) ); # No tail too short for Δt
+Filter = FilterDesign( Variables, FilterKind, FilterLow, FilterHigh ); # nothing when no filter is selected
 n0s = length( string( N ) );
+MemEstimate = round( EstimateMemory( fs ), digits = 2 ); # Expected peak of the process in GB
 
 # STEP00-General Dirs
 PATHMAIN = joinpath( dirname( dirname( FILEBRW ) ), split( basename( FILEBRW ), "." )[ 1 ] );
@@ -61,20 +80,44 @@ PATHSTEP00 = joinpath( PATHMAIN, "STEP00" ); mkpath( PATHSTEP00 );
 PATHFIGURES = joinpath( PATHMAIN, "Figures" );
 PATHFIGURES_STEP00 = joinpath( PATHFIGURES, "STEP00" ); mkpath( PATHFIGURES_STEP00 );
 PATHSPECTROGRAMS = joinpath( PATHFIGURES, "Spectrograms" ); mkpath( PATHSPECTROGRAMS );
+# The band, spike and connectivity maps come from their stores now ( BandResults ), figures of older runs would shadow them
+foreach( m -> rm( joinpath( PATHFIGURES, m ); force = true, recursive = true ), [ uppercase.( first.( Bands ) ); "SPIKES"; "CONNECTIVITY" ] );
 
 # STEP00-General .jld2
-FILESTEP00 = joinpath( PATHINFO, "STEP00.jld2" );
+FILESTEP00 = joinpath( PATHINFO, "STEP00.res" ); # Results store, see SaveResults
 FILEPARAMETERS = joinpath( PATHINFO, "Parameters.jld2" );
+FILEMEMORY = joinpath( PATHINFO, "Memory.jld2" );
+FILEPYRAMID = joinpath( PATHINFO, "Pyramid.bin" ); # Min/max/RMS pyramid for the trace viewer
+FILESKETCH = joinpath( PATHINFO, "Sketch.bin" ); # Mergeable segment statistics, see OpenSketch
+SketchSplit = 4; # Base blocks per segment of the sketch
+PreviewWindows = 8; # Runs of chunks read per segment by the quick look, see PreviewSegment
+FollowSeconds = 10; # Segment length while following a recording still being written, see FollowFrames
+FILEBANDS = joinpath( PATHINFO, "BANDS.jld2" );
+FILESPIKES = joinpath( PATHINFO, "SPIKES.jld2" );
 
 # Pre-allocating arrays to store the results for all N segments
 Cardinality = Array{ Any }( undef, N ); fill!( Cardinality, [ ] );
 VoltageShiftDeviation = Array{ Any }( undef, N ); fill!( VoltageShiftDeviation, [ ] );
 Empties = Array{ Any }( undef, N ); fill!( Empties, [ ] );
+MemoryLog = Array{ Any }( undef, N ); fill!( MemoryLog, [ ] );
+BandAbs = Array{ Any }( undef, N ); fill!( BandAbs, [ ] );
+BandRel = Array{ Any }( undef, N ); fill!( BandRel, [ ] );
+FiringRate = Array{ Any }( undef, N ); fill!( FiringRate, [ ] );
+SpikeNoise = Array{ Any }( undef, N ); fill!( SpikeNoise, [ ] );
+SpikeTimes = Array{ Any }( undef, N ); fill!( SpikeTimes, [ ] );
+LocalCorr = Array{ Any }( undef, N ); fill!( LocalCorr, [ ] );
+GlobalCorr = Array{ Any }( undef, N ); fill!( GlobalCorr, [ ] );
 
 # Some parameters for initialize the segments arrays
 nChs = Variables[ "nChs" ];
-nfrs = floor( Int, ( Variables[ "NRecFrames" ] / N ) );
-RAW  = h5open( Variables[ "BRWNAME" ], "r" )[ Variables[ "RAW" ] ];
+nfrs = Variables[ "SegmentFrames" ];
+fr0, frN = SegmentFrames( Variables, N, N );
+ArenaFrames = max( nfrs, frN - fr0 + 1 ); # Longest segment, sizes the arena buffers
+ftmin = round( min( nfrs, frN - fr0 + 1 ) / Variables[ "SamplingRate" ], digits = 3 ); # Shortest segment
+RAW = OpenRaw( Variables; swmr = Following ); # Memory-mapped when the dataset is contiguous and uncompressed; kept open while following, see Follow!
+
+# Everything the STEP00 results depend on, with the BRW the key of a run in the artifact cache
+RunParameters( ) = ArtifactParameters( ; limSat, THR_EMP, Δt, cm_, N, nfrs = Variables[ "SegmentFrames" ], Filter = ( FilterKind, FilterLow, FilterHigh ), Window = get( Variables, "Window", nothing ), Channels = get( Variables, "Channels", nothing ), Connectivity, SpikeTimestamps, SketchSplit );
 
 #@time for n = 1:N
 #    BINRAW = OneSegment( RAW, Variables, n, N );
@@ -38,29 +38,38 @@ PATHFIGURES = joinpath( PATHMAIN, "Figures" );
 PATHFIGURES_STEP01 = joinpath( PATHFIGURES, "STEP01" ); mkpath( PATHFIGURES_STEP01 );
 PATHFIGURES_GENERAL = joinpath( PATHFIGURES, "GENERAL" ); mkpath( PATHFIGURES_GENERAL );
 
-FILESTEP01 = joinpath( PATHMAIN, "Info", "STEP01.jld2" );
+FILESTEP01 = joinpath( PATHMAIN, "Info", "STEP01.res" ); # Results store, see SaveResults
 FILEVARIABLES = joinpath( PATHINFO, "Variables.jld2" );
-FILESTEP00 = joinpath( PATHMAIN, "Info", "STEP00.jld2" );
 FILEPARAMETERS = joinpath( PATHINFO, "Parameters.jld2" );
+FILEMEMORY = joinpath( PATHINFO, "Memory.jld2" );
 FILESVOLTAGE = SearchDir( PATHSTEP00, ".jld2" );
 
 Variables = LoadDict( FILEVARIABLES );
-step00 = LoadDict( FILESTEP00 );
+step00 = StepResults( PATHINFO, "STEP00" );
 Parameters = LoadDict( FILEPARAMETERS );
 
 N = Parameters[ "N" ];
+Variables[ "SegmentFrames" ] = get( Parameters, "nfrs", floor( Int, Variables[ "NRecFrames" ] / N ) );
+haskey( Parameters, "Window" ) && ( Variables[ "Window" ] = Parameters[ "Window" ] ); # Same frames as STEP00
+# Segments come from the BRW when STEP00 did not dump them, or dumped only the channels of a ROI
+Streaming = !get( Parameters, "SaveBIN", true ) || haskey( Parameters, "Channels" );
+fr0, frN = SegmentFrames( Variables, N, N );
+ArenaFrames = max( Variables[ "SegmentFrames" ], frN - fr0 + 1 ); # Longest segment, sizes the arena buffers
+MaxGB = Parameters[ "MaxGB" ]; # Memory budget for the segment loop
+Filter = FilterDesign( Variables, get( Parameters, "Filter", ( "None", 0, 0 ) )... ); # Same filter as STEP00, fresh state
 
 cte = 100; # μV of range that are assigned to the maximum voltage to set the threshold for saturation.
 MaxVolt = Variables[ "MaxVolt" ]; # Maximum possible voltage registered by the equipment
 THR_SES = abs( MaxVolt - cte ); # Threshold to be considered for setting saturation
-plotfonts = Plots.font( pointsize = 10, family = "sans-serif" ); # Font type for all the plots
 
 minchan = 8; # minimum channels for channel reconstruction
 maxrad = 4; # maximum ratio of neighborhood, for channel reconstruction
 maxIt = 5; # maximum number of iterations, for channel reconstruction
 
+# The STEP00 run it starts from and the STEP01 settings, with the BRW the key of the artifact cache
+Step01Parameters( ) = ArtifactParameters( merge( Parameters, Dict( "STEP01" => ( limSat, THR_EMP, Δt, cm_ ), "THR_SES" => THR_SES, "minchan" => minchan, "maxrad" => maxrad, "maxIt" => maxIt ) ) );
+
 n0s = length( string( N ) ); # Suffix for STEP01-Figures-name
-l = @layout [ a{ 0.48w, 1.0h } b{ 0.52w, 1.0h } ]; # Layout for save STEP01-Figures
 
 Empties = step00[ "Empties" ];
 
@@ -88,6 +97,7 @@ Cardinality = Array{ Any }( undef, N ); fill!( Cardinality, [ ] );
 VoltageShiftDeviation = Array{ Any }( undef, N ); fill!( VoltageShiftDeviation, [ ] );
 Sats = Array{ Any }( undef, N ); fill!( Sats, [ ] );
 Repaired = Array{ Any }( undef, N ); fill!( Repaired, [ ] );
+MemoryLog = Array{ Any }( undef, N ); fill!( MemoryLog, [ ] );
 
 #channel = 1;
 #n1 = 8200;
@@ -15,6 +15,7 @@ using Suppressor
 libraries = ["BinningAnalysis",
              "Dates",
              "DSP",
+             "FFTW",
              "HDF5",
              "HistogramThresholding",
              "JLD2",
@@ -0,0 +1,94 @@
+"""
+    Stand-in for BrainWave while it records: copies a finished BRW into a new file at the rate
+    it was recorded ( or `speed` times faster ), so the follow mode of Evaluate can be tried
+    without a rig. Everything but the raw dataset is copied first; the raw dataset is created
+    extendible and grows by `step` seconds per write, as a SWMR writer.
+
+        julia STANDIN_WRITER.jl source.brw target.brw [ speed = 1 ] [ step = 1 ]
+
+    GetVarsHDF5 reads the source, so its Info folder is written as for an evaluation.
+
+    Manual test of the follow mode:
+    1. Start the writer on a finished recording, e.g. 4 times faster with 1 s writes:
+        julia STANDIN_WRITER.jl source.brw target.brw 4 1
+    2. In the GUI select target.brw, check Follow, leave the window at 0 - 0 s and Evaluate.
+    3. SEGMENTS grows every FollowSeconds of recording and the maps of the newest segment
+    are shown; the trend and the Raw Bin Behavior grow with them.
+    4. When the writer ends the follow stops by itself after a minute ( or press Stop ); the
+    number of segments must be fld( frames of the source, FollowFrames ), and STEP00.res,
+    Sketch.bin and the atlases open as for any other run.
+    5. With a time window set, Evaluate with Follow must refuse to start.
+"""
+push!( LOAD_PATH, dirname(@__FILE__) );
+
+using AllSTEPs
+using HDF5
+
+source, target = ARGS[ 1 ], ARGS[ 2 ];
+speed = length( ARGS ) > 2 ? parse( Float64, ARGS[ 3 ] ) : 1.0;
+step = length( ARGS ) > 3 ? parse( Float64, ARGS[ 4 ] ) : 1.0;
+
+Variables = GetVarsHDF5( source );
+RAWPATH = Variables[ "RAW" ];
+nChs = Variables[ "nChs" ];
+fs = Variables[ "SamplingRate" ];
+cf = Variables[ "ChunkFrames" ];
+
+# Groups, datasets and attributes of the source, but the raw dataset
+function CopyExcept!( src, dst, skip::String )
+    for ( k, v ) in attrs( src )
+        attrs( dst )[ k ] = v;
+    end
+    for k in keys( src )
+        o = src[ k ];
+        if o isa HDF5.Group
+            CopyExcept!( o, create_group( dst, k ), skip );
+        elseif HDF5.name( o ) != skip
+            copy_object( o, dst, k );
+        end
+        close( o );
+    end
+end
+
+SRC = h5open( source, "r" );
+R = SRC[ RAWPATH ];
+TwoD = ndims( R ) == 2;
+Frames = TwoD ? size( R, 2 ) : length( R ) ÷ nChs;
+per = max( cf, round( Int, step * fs ) ); # Frames per write
+
+DST = h5open( target, "w"; libver_bounds = ( :latest, :latest ) );
+CopyExcept!( SRC, DST, RAWPATH );
+if TwoD
+    D = create_dataset( DST, RAWPATH, UInt16, ( ( nChs, 0 ), ( nChs, -1 ) ); chunk = ( nChs, cf ) );
+else
+    D = create_dataset( DST, RAWPATH, UInt16, ( ( 0, ), ( -1, ) ); chunk = ( nChs * cf, ) );
+end
+
+# Appends frames a:b of the source and makes them visible to the readers
+function Append!( a::Int, b::Int )
+    if TwoD
+        HDF5.set_extent_dims( D, ( nChs, b ) );
+        D[ :, a:b ] = R[ :, a:b ];
+    else
+        HDF5.set_extent_dims( D, ( b * nChs, ) );
+        D[ ( ( a - 1 ) * nChs + 1 ):( b * nChs ) ] = R[ ( ( a - 1 ) * nChs + 1 ):( b * nChs ) ];
+    end
+    flush( DST );
+end
+
+# The first write before the readers come in: the raw dataset is the biggest one from then on
+Append!( 1, min( per, Frames ) );
+HDF5.start_swmr_write( DST );
+println( "Writing ", target, " at ", speed, "x" );
+
+for a in ( per + 1 ):per:Frames
+    b = min( a + per - 1, Frames );
+    t = @elapsed Append!( a, b );
+    sleep( max( 0.0, ( b - a + 1 ) / fs / speed - t ) );
+    println( "Recorded: ", round( b / fs, digits = 1 ), " s" );
+end
+
+close( D );
+close( DST );
+close( SRC );
+println( "Recording finished: ", round( Frames / fs, digits = 1 ), " s" );